@@ -2,25 +2,74 @@ extern crate bindgen;
 extern crate cc;
 
 use std::env;
+use std::fs;
 use std::path::PathBuf;
 
+// BCH (m, t) parameters to build specialized codecs for, as "m:t" pairs
+// separated by commas or spaces, e.g. BCHLIB_FIXED_PARAMS="13:8,14:16"
+fn fixed_params() -> Vec<(u32, u32)> {
+    println!("cargo:rerun-if-env-changed=BCHLIB_FIXED_PARAMS");
+    let spec = env::var("BCHLIB_FIXED_PARAMS").unwrap_or_default();
+    let mut params: Vec<(u32, u32)> = spec
+        .split(|c: char| c == ',' || c.is_whitespace())
+        .filter(|s| !s.is_empty())
+        .map(|s| {
+            let mut mt = s.splitn(2, ':').map(|v| v.trim().parse::<u32>());
+            match (mt.next(), mt.next()) {
+                (Some(Ok(m)), Some(Ok(t))) => (m, t),
+                _ => panic!("BCHLIB_FIXED_PARAMS: invalid entry {:?}, expected m:t", s),
+            }
+        })
+        .collect();
+    if env::var("CARGO_FEATURE_TEST_FIXED_PARAMS").is_ok() {
+        params.push((14, 16));
+    }
+    params.sort();
+    params.dedup();
+    params
+}
+
 fn main() {
-    cc::Build::new().
+    let wide_field = std::env::var("CARGO_FEATURE_WIDE_FIELD").is_ok();
+    let out_path = PathBuf::from(env::var("OUT_DIR").unwrap());
+    let fixed = fixed_params();
+
+    let mut build = cc::Build::new();
+    build.
 	file("src/bch/bch.c").
+	include("src/bch").
 	flag("-Wno-sign-compare").
 	flag("-Wno-unused-parameter").
-	flag("-Wno-stringop-overflow").
-	compile("bch");
+	flag("-Wno-stringop-overflow");
+    if wide_field {
+        build.define("BCH_WIDE_FIELD", None);
+    }
+    if !fixed.is_empty() {
+        // one specialized copy of bch.c per configuration, see BCH_CONST_M
+        let mut list = String::new();
+        for &(m, t) in fixed.iter() {
+            let src = out_path.join(format!("bch_m{}_t{}.c", m, t));
+            fs::write(&src, format!("#define BCH_CONST_M {}\n#define BCH_CONST_T {}\n\
+                                     #include \"bch.c\"\n", m, t))
+                .expect("Couldn't write specialized codec source!");
+            build.file(src);
+            list.push_str(&format!("BCH_FIXED({},{})", m, t));
+        }
+        build.define("BCH_FIXED_PARAMS", Some(list.as_str()));
+    }
+    build.compile("bch");
 
     let mut bindings = bindgen::Builder::default()
         .header("src/bch/bch.h");
+    if wide_field {
+        bindings = bindings.clang_arg("-DBCH_WIDE_FIELD");
+    }
 
     let use_std = std::env::var("CARGO_FEATURE_STD").is_ok();
     if !use_std {
         bindings = bindings.use_core();
     }
-    
-    let out_path = PathBuf::from(env::var("OUT_DIR").unwrap());
+
     bindings
         .generate()
         .expect("Unable to generate bindings")
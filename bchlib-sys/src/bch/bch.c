@@ -37,7 +37,9 @@
  * Algorithmic details:
  *
  * Encoding is performed by processing 32 input bits in parallel, using 4
- * remainder lookup tables.
+ * remainder lookup tables (or 64/128 bits using 8/16 tables, see
+ * init_bch_ext()). On x86-64 CPUs supporting PCLMULQDQ, 128 input bits are
+ * instead folded into the remainder at each step with carry-less multiplies.
  *
  * The final stage of decoding involves the following internal steps:
  * a. Syndrome computation
@@ -62,6 +64,48 @@
  *  2015-05  Mark Borgerding (mark@borgerding.net): replaced linux kernel-specific functions, added bitwise encode/decode functions
  */
 
+/*
+ * Compile-time specialized codecs: building this file with BCH_CONST_M and
+ * BCH_CONST_T defined yields a codec supporting these parameters only, with a
+ * constant field size, error count and ecc word count, so that GF(2^m) helpers
+ * fold them and remainder update loops have constant trip counts. Its public
+ * functions get a _m<M>_t<T> suffix, so that it links with the generic build;
+ * the generic init_bch_ext() hands matching parameters over to it if it is
+ * listed in BCH_FIXED_PARAMS, e.g. -DBCH_FIXED_PARAMS="BCH_FIXED(13,8)".
+ */
+#define BCH_FIXED_NAME(_name, M, T)  _name##_m##M##_t##T
+#define BCH_FIXED_NAME_(_name, M, T) BCH_FIXED_NAME(_name, M, T)
+
+#ifdef BCH_CONST_M
+#define BCH_FIXED_SYM(_name)   BCH_FIXED_NAME_(_name, BCH_CONST_M, BCH_CONST_T)
+#define init_bch               BCH_FIXED_SYM(init_bch)
+#define init_bch_ext           BCH_FIXED_SYM(init_bch_ext)
+#define free_bch               BCH_FIXED_SYM(free_bch)
+#define encode_bch             BCH_FIXED_SYM(encode_bch)
+#define encode_bch_crc         BCH_FIXED_SYM(encode_bch_crc)
+#define encodev_bch            BCH_FIXED_SYM(encodev_bch)
+#define init_bch_encoder       BCH_FIXED_SYM(init_bch_encoder)
+#define free_bch_encoder       BCH_FIXED_SYM(free_bch_encoder)
+#define encode_bch_init        BCH_FIXED_SYM(encode_bch_init)
+#define encode_bch_update      BCH_FIXED_SYM(encode_bch_update)
+#define encode_bch_final       BCH_FIXED_SYM(encode_bch_final)
+#define encode_bch_batch       BCH_FIXED_SYM(encode_bch_batch)
+#define encodebits_bch         BCH_FIXED_SYM(encodebits_bch)
+#define encodebits_bch_sliced  BCH_FIXED_SYM(encodebits_bch_sliced)
+#define bch_slice_bits         BCH_FIXED_SYM(bch_slice_bits)
+#define bch_unslice_bits       BCH_FIXED_SYM(bch_unslice_bits)
+#define bch_verify             BCH_FIXED_SYM(bch_verify)
+#define bch_verify_batch       BCH_FIXED_SYM(bch_verify_batch)
+#define bch_update_ecc         BCH_FIXED_SYM(bch_update_ecc)
+#define bch_set_thread_pool    BCH_FIXED_SYM(bch_set_thread_pool)
+#define decode_bch             BCH_FIXED_SYM(decode_bch)
+#define decodev_bch            BCH_FIXED_SYM(decodev_bch)
+#define decodebits_bch         BCH_FIXED_SYM(decodebits_bch)
+#define correct_bch            BCH_FIXED_SYM(correct_bch)
+#define correctbits_bch        BCH_FIXED_SYM(correctbits_bch)
+#define bch_check_free         BCH_FIXED_SYM(bch_check_free)
+#endif
+
 #include "bch.h"
 #include <stddef.h>
 
@@ -107,21 +151,145 @@ static inline int FLS(uint32_t x)
 
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof(*(a)))
 
+#ifdef BCH_CONST_M
+#define GF_M(_p)               (BCH_CONST_M)
+#define GF_T(_p)               (BCH_CONST_T)
+#define GF_N(_p)               ((1u << (BCH_CONST_M))-1)
+#else
 #define GF_M(_p)               ((_p)->m)
 #define GF_T(_p)               ((_p)->t)
 #define GF_N(_p)               ((_p)->n)
+#endif
 
 #ifndef DIV_ROUND_UP
 #define DIV_ROUND_UP(n,d) (((n) + (d) - 1) / (d))
 #endif
 
+/* largest supported m, and number of 4-bit nibbles of GF(2^m) elements */
+#ifdef BCH_WIDE_FIELD
+#define BCH_MAX_M              20
+#else
+#define BCH_MAX_M              15
+#endif
+#define BCH_GF_NIBBLES         DIV_ROUND_UP(BCH_MAX_M, 4)
+
 #define BCH_ECC_WORDS(_p)      DIV_ROUND_UP(GF_M(_p)*GF_T(_p), 32)
 #define BCH_ECC_BYTES(_p)      DIV_ROUND_UP(GF_M(_p)*GF_T(_p), 8)
 
+/*
+ * per odd syndrome entries of bch->minpoly_tab: degree of the minimal
+ * polynomial, 256-entry reduction table, BCH_GF_NIBBLES 16-entry evaluation
+ * tables
+ */
+#define BCH_MINPOLY_TAB_SZ     (1+256+16*BCH_GF_NIBBLES)
+
+/*
+ * largest t for which BCH_ENC_NIBBLE decoding evaluates syndromes on data,
+ * without vector syndrome kernels
+ */
+#define BCH_SYN_DIRECT_MAX_T   8
+
+/*
+ * memory budget in bytes of each polynomial root lookup table built with
+ * BCH_DEC_ROOT_TABLES, may be overridden at build time; the default allows the
+ * 2^m-entry quadratic table up to m = 12 (m = 11 with BCH_WIDE_FIELD)
+ */
+#ifndef BCH_ROOT_TAB_BUDGET
+#define BCH_ROOT_TAB_BUDGET    8192
+#endif
+
+/* bit-sliced encoder window slide period, in input bits */
+#define BCH_SLICED_BLOCK       32
+
+/*
+ * largest m*t supported by the bit-sliced encoder, whose taps and feedback
+ * buffers (about 32*m*t bytes) are allocated on its first call
+ */
+#define BCH_SLICED_MAX_BITS    256
+
+#ifdef __GNUC__
+#define BCH_ALWAYS_INLINE      inline __attribute__((always_inline))
+#else
+#define BCH_ALWAYS_INLINE      inline
+#endif
+
+/*
+ * fully unroll remainder update loops when their trip count is constant (see
+ * BCH_CONST_M), so that remainder words stay in registers: vectorized, each
+ * update would reload words just stored by the previous one, misaligned, and
+ * stall on store forwarding
+ */
+#if defined(BCH_CONST_M) && defined(__GNUC__)
+#define BCH_UNROLL             _Pragma("GCC unroll 64")
+#else
+#define BCH_UNROLL
+#endif
+
 #ifndef dbg
 #define dbg(_fmt, args...)     do {} while (0)
 #endif
 
+/*
+ * remainder tables are stored, and table-driven encoder loops run, using
+ * "native" words, i.e. 32-bit words as loaded from the big-endian ecc/data
+ * byte stream. On little-endian cpus these are byte-swapped with respect to
+ * the polynomial representation used elsewhere, so that input data words can
+ * be consumed without any swizzle; on other cpus both are identical.
+ */
+#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__) && \
+        (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define BCH_NATIVE_LE
+/* byte of native word _w with weight 8*_k in polynomial representation */
+#define NATIVE_BYTE(_w, _k)    (((_w) >> (24-8*(_k))) & 0xff)
+/* multiply native words _hi,_lo by X^8, dropping the leading byte of _hi */
+#define NATIVE_SHL8(_hi, _lo)  (((_hi) >> 8)|((_lo) << 24))
+#define NATIVE_DATA32(_w)      (_w)
+#else
+#define NATIVE_BYTE(_w, _k)    (((_w) >> (8*(_k))) & 0xff)
+#define NATIVE_SHL8(_hi, _lo)  (((_hi) << 8)|((_lo) >> 24))
+#define NATIVE_DATA32(_w)      CPU_TO_BE32(_w)
+#endif
+
+/*
+ * convert a word between polynomial and native representations (this is an
+ * involution)
+ */
+static inline uint32_t NATIVE32(uint32_t x)
+{
+#ifdef BCH_NATIVE_LE
+#ifdef __GNUC__
+        return __builtin_bswap32(x);
+#else
+        return (x >> 24)|((x >> 8) & 0xff00)|((x << 8) & 0xff0000)|(x << 24);
+#endif
+#else
+        return x;
+#endif
+}
+
+/*
+ * read a native word from (possibly unaligned) big-endian data
+ */
+static inline uint32_t LOAD_NATIVE32(const uint8_t *p)
+{
+#ifdef BCH_NATIVE_LE
+        return (uint32_t)p[0]|((uint32_t)p[1] << 8)|((uint32_t)p[2] << 16)|
+                ((uint32_t)p[3] << 24);
+#else
+        return ((uint32_t)p[0] << 24)|((uint32_t)p[1] << 16)|
+                ((uint32_t)p[2] << 8)|(uint32_t)p[3];
+#endif
+}
+
+/*
+ * read a little-endian word from (possibly unaligned) data
+ */
+static inline uint32_t LOAD_LE32(const uint8_t *p)
+{
+        return (uint32_t)p[0]|((uint32_t)p[1] << 8)|((uint32_t)p[2] << 16)|
+                ((uint32_t)p[3] << 24);
+}
+
 /*
  * represent a polynomial over GF(2^m)
  */
@@ -139,8 +307,122 @@ struct gf_poly_deg1 {
         unsigned int   c[2];
 };
 
+/* pending factor of the BTZ work stack, to be split with Tr(a^kX) */
+struct btz_item {
+        struct gf_poly *f;
+        unsigned int    k;
+};
+
 /*
- * same as encode_bch(), but process input data one byte at a time
+ * entry points of a compile-time specialized codec (see BCH_CONST_M); the
+ * generic build forwards calls on control structures that the specialized
+ * init_bch_ext() created
+ */
+struct bch_fixed_codec {
+        unsigned int m;
+        unsigned int t;
+        struct bch_control *(*init_bch_ext)(int m, int t,
+                                            unsigned int prim_poly,
+                                            unsigned int flags);
+        void (*free_bch)(struct bch_control *bch);
+        int  (*bch_set_thread_pool)(struct bch_control *bch,
+                                    const struct bch_thread_pool *pool);
+        void (*encode_bch)(struct bch_control *bch, const uint8_t *data,
+                           unsigned int len, uint8_t *ecc);
+        int  (*encode_bch_crc)(struct bch_control *bch, const uint8_t *data,
+                               unsigned int len, struct bch_encode_out *out);
+        void (*encodev_bch)(struct bch_control *bch,
+                            const struct bch_iovec *iov, unsigned int iovcnt,
+                            uint8_t *ecc);
+        struct bch_encoder *(*init_bch_encoder)(struct bch_control *bch);
+        void (*free_bch_encoder)(struct bch_encoder *enc);
+        void (*encode_bch_init)(struct bch_encoder *enc, const uint8_t *ecc);
+        void (*encode_bch_update)(struct bch_encoder *enc, const uint8_t *data,
+                                  unsigned int len);
+        void (*encode_bch_final)(struct bch_encoder *enc, uint8_t *ecc);
+        void (*encode_bch_batch)(struct bch_control *bch,
+                                 const uint8_t * const *data, unsigned int len,
+                                 uint8_t * const *ecc, unsigned int count);
+        void (*encodebits_bch)(struct bch_control *bch, const uint8_t *data,
+                               uint8_t *ecc);
+        int  (*encodebits_bch_sliced)(struct bch_control *bch,
+                                      const uint64_t *data, unsigned int nbits,
+                                      uint64_t *ecc, unsigned int lanes);
+        int  (*bch_verify)(struct bch_control *bch, const uint8_t *data,
+                           unsigned int len, const uint8_t *ecc);
+        int  (*bch_verify_batch)(struct bch_control *bch,
+                                 const uint8_t * const *data, unsigned int len,
+                                 const uint8_t * const *ecc, unsigned int count,
+                                 uint8_t *dirty);
+        int  (*bch_update_ecc)(struct bch_control *bch, uint8_t *ecc,
+                               unsigned int len, unsigned int offset,
+                               const uint8_t *old_data,
+                               const uint8_t *new_data, unsigned int n);
+        int  (*decode_bch)(struct bch_control *bch, const uint8_t *data,
+                           unsigned int len, const uint8_t *recv_ecc,
+                           const uint8_t *calc_ecc, const unsigned int *syn,
+                           unsigned int *errloc);
+        int  (*decodev_bch)(struct bch_control *bch,
+                            const struct bch_iovec *iov, unsigned int iovcnt,
+                            const uint8_t *recv_ecc, unsigned int *errloc);
+        int  (*decodebits_bch)(struct bch_control *bch, const uint8_t *data,
+                               const uint8_t *recv_ecc, unsigned int *errloc);
+        void (*correct_bch)(struct bch_control *bch, uint8_t *data,
+                            unsigned int len, unsigned int *errloc, int nerr);
+        void (*correctbits_bch)(struct bch_control *bch, uint8_t *databits,
+                                unsigned int *errloc, int nerr);
+};
+
+#ifdef BCH_CONST_M
+extern const struct bch_fixed_codec BCH_FIXED_SYM(bch_fixed_codec);
+#elif defined(BCH_FIXED_PARAMS)
+#define BCH_FIXED(_m, _t) \
+        extern const struct bch_fixed_codec BCH_FIXED_NAME(bch_fixed_codec, _m, _t);
+BCH_FIXED_PARAMS
+#undef BCH_FIXED
+
+static const struct bch_fixed_codec *const bch_fixed_codecs[] = {
+#define BCH_FIXED(_m, _t) &BCH_FIXED_NAME(bch_fixed_codec, _m, _t),
+        BCH_FIXED_PARAMS
+#undef BCH_FIXED
+};
+
+/* generic build: forward a call to the specialized codec that created _bch */
+#define BCH_FIXED_CALL(_bch, _fn, _args)                                \
+        do {                                                            \
+                if ((_bch)->fixed) {                                    \
+                        (_bch)->fixed->_fn _args;                       \
+                        return;                                         \
+                }                                                       \
+        } while (0)
+#define BCH_FIXED_RETURN(_bch, _fn, _args)                              \
+        do {                                                            \
+                if ((_bch)->fixed)                                      \
+                        return (_bch)->fixed->_fn _args;                \
+        } while (0)
+#endif
+
+#ifndef BCH_FIXED_CALL
+#define BCH_FIXED_CALL(_bch, _fn, _args)   do {} while (0)
+#define BCH_FIXED_RETURN(_bch, _fn, _args) do {} while (0)
+#endif
+
+/*
+ * convert ecc words between polynomial and native representations, in place
+ */
+static inline void ecc_native(struct bch_control *bch, uint32_t *ecc)
+{
+#ifdef BCH_NATIVE_LE
+        unsigned int i;
+
+        for (i = 0; i < BCH_ECC_WORDS(bch); i++)
+                ecc[i] = NATIVE32(ecc[i]);
+#endif
+}
+
+/*
+ * same as encode_bch(), but process input data one byte at a time; @ecc is in
+ * native representation
  */
 static void encode_bch_unaligned(struct bch_control *bch,
                                  const unsigned char *data, unsigned int len,
@@ -151,12 +433,76 @@ static void encode_bch_unaligned(struct bch_control *bch,
         const int l = BCH_ECC_WORDS(bch)-1;
 
         while (len--) {
-                p = bch->mod8_tab + (l+1)*(((ecc[0] >> 24)^(*data++)) & 0xff);
+                p = bch->mod8_tab + (l+1)*(NATIVE_BYTE(ecc[0], 3)^(*data++));
 
+                BCH_UNROLL
                 for (i = 0; i < l; i++)
-                        ecc[i] = ((ecc[i] << 8)|(ecc[i+1] >> 24))^(*p++);
+                        ecc[i] = NATIVE_SHL8(ecc[i], ecc[i+1])^(*p++);
+
+                ecc[l] = NATIVE_SHL8(ecc[l], 0)^(*p);
+        }
+}
 
-                ecc[l] = (ecc[l] << 8)^(*p);
+/*
+ * multiply remainder @ecc (in polynomial representation) by X^@nbits modulo
+ * g(X), one bit at a time: this is the plain LFSR over the generator polynomial
+ */
+static void encode_bch_lfsr(struct bch_control *bch, uint32_t *ecc,
+                            unsigned int nbits)
+{
+        const unsigned int l = BCH_ECC_WORDS(bch)-1;
+        const unsigned int plen = DIV_ROUND_UP(bch->ecc_bits+1, 32);
+        const uint32_t *g = bch->genpoly;
+        unsigned int i;
+        uint32_t mask, gi;
+
+        while (nbits--) {
+                /* subtract X^deg(g) term, i.e. add g(X) if it is set */
+                mask = -(ecc[0] >> 31);
+                for (i = 0; i <= l; i++) {
+                        gi = (i < plen) ? g[i] << 1 : 0;
+                        if (i+1 < plen)
+                                gi |= g[i+1] >> 31;
+                        ecc[i] = ((ecc[i] << 1)|((i < l) ? ecc[i+1] >> 31 : 0))^
+                                (mask & gi);
+                }
+        }
+}
+
+/*
+ * low-memory encoders (see init_bch_ext()): process input data one nibble at a
+ * time using the 16-entry remainder table, or one bit at a time if there is no
+ * table; @ecc is in polynomial representation
+ */
+static void encode_bch_compact(struct bch_control *bch, const uint8_t *data,
+                               unsigned int len, uint32_t *ecc)
+{
+        const unsigned int l = BCH_ECC_WORDS(bch)-1;
+        const uint32_t * const tab = bch->mod4_tab;
+        const uint32_t *p;
+        unsigned int i, k;
+
+        if (!tab) {
+                while (len--) {
+                        ecc[0] ^= (uint32_t)(*data++) << 24;
+                        encode_bch_lfsr(bch, ecc, 8);
+                }
+                return;
+        }
+
+        while (len--) {
+                /* high nibble first */
+                for (k = 0; k < 2; k++) {
+                        p = tab+(l+1)*(((ecc[0] >> 28)^
+                                        (*data >> (4-4*k))) & 0xf);
+
+                        BCH_UNROLL
+                        for (i = 0; i < l; i++)
+                                ecc[i] = ((ecc[i] << 4)|(ecc[i+1] >> 28))^p[i];
+
+                        ecc[l] = (ecc[l] << 4)^p[l];
+                }
+                data++;
         }
 }
 
@@ -198,45 +544,310 @@ static void store_ecc8(struct bch_control *bch, uint8_t *dst,
         bch_memcpy(dst, pad, BCH_ECC_BYTES(bch)-4*nwords);
 }
 
-/**
- * encode_bch - calculate BCH ecc parity of data
- * @bch:   BCH control structure
- * @data:  data to encode
- * @len:   data length in bytes
- * @ecc:   ecc parity data, must be initialized by caller
+/*
+ * process @ngroups blocks of @k aligned 32-bit data words (slicing-by-4k),
+ * using the 4*@k remainder tables built when @bch was initialized; remainder
+ * @r is in native representation
  *
- * The @ecc parity array is used both as input and output parameter, in order to
- * allow incremental computations. It should be of the size indicated by member
- * @ecc_bytes of @bch, and should be initialized to 0 before the first call.
+ * this is the same decomposition as in encode_bch(), with table s holding
+ * (p(X).X^(8*s+deg(g))) mod g; all lookups of an iteration only depend on the
+ * previous remainder, so they can be issued in parallel
+ */
+static inline void encode_bch_slice(struct bch_control *bch,
+                                    const uint32_t *pdata, unsigned int ngroups,
+                                    uint32_t *r, const unsigned int k)
+{
+        const unsigned int l = BCH_ECC_WORDS(bch)-1;
+        const uint32_t *p[16];
+        unsigned int i, j, s;
+        uint32_t w, acc;
+
+        while (ngroups--) {
+                for (j = 0; j < k; j++) {
+                        /* input data is read in big-endian format */
+                        w = ((j <= l) ? r[j] : 0)^NATIVE_DATA32(pdata[j]);
+                        s = 4*(k-1-j);
+                        p[s+0] = bch->mod8_tab + (l+1)*(256*(s+0)+NATIVE_BYTE(w, 0));
+                        p[s+1] = bch->mod8_tab + (l+1)*(256*(s+1)+NATIVE_BYTE(w, 1));
+                        p[s+2] = bch->mod8_tab + (l+1)*(256*(s+2)+NATIVE_BYTE(w, 2));
+                        p[s+3] = bch->mod8_tab + (l+1)*(256*(s+3)+NATIVE_BYTE(w, 3));
+                }
+                pdata += k;
+
+                BCH_UNROLL
+                for (i = 0; i <= l; i++) {
+                        acc = (i+k <= l) ? r[i+k] : 0;
+                        acc ^= p[0][i]^p[1][i]^p[2][i]^p[3][i]^
+                                p[4][i]^p[5][i]^p[6][i]^p[7][i];
+                        if (k == 4)
+                                acc ^= p[8][i]^p[9][i]^p[10][i]^p[11][i]^
+                                        p[12][i]^p[13][i]^p[14][i]^p[15][i];
+                        r[i] = acc;
+                }
+        }
+}
+
+/*
+ * number of interleaved remainder chains in encode_bch_batch(), and largest
+ * ecc size (in words) for which interleaving table chains pays off
+ */
+#define BCH_BATCH_WAYS         4
+#define BCH_BATCH_MAX_WORDS    8
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define BCH_HAVE_CLMUL
+#include <wmmintrin.h>
+#include <immintrin.h>
+
+/* number of 128-bit limb pairs holding ecc_bits, and chunks per window slide */
+#define BCH_ECC_PAIRS(_p)      DIV_ROUND_UP((_p)->ecc_bits, 128)
+#define BCH_CLMUL_BLOCK        32
+/*
+ * shortest input worth the carry-less multiply setup cost; smaller buffers
+ * (e.g. header fragments given to encodev_bch()) are faster with tables
+ */
+#define BCH_CLMUL_MIN_LEN      32
+/* encode_bch_crc() block size when the CRC is a separate pass */
+#define BCH_CRC_BLOCK          4096
+/*
+ * shortest inputs worth the vector syndrome kernels: below 128 bytes, folding
+ * 32 lanes costs more than the 16-byte kernel saves
+ */
+#define BCH_SYN_VEC_MIN_LEN    16
+#define BCH_SYN_AVX2_MIN_LEN   128
+/*
+ * estimated cost in cycles of handing a parallel Chien search over to the
+ * caller thread pool and waiting for its completion (waking idle workers up)
+ */
+#define BCH_POOL_DISPATCH_CYCLES 20000
+
+static int cpu_has_clmul(void)
+{
+        /* CPUID.01H:ECX.PCLMULQDQ */
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("pclmul");
+}
+
+static int cpu_has_avx2(void)
+{
+        /* CPUID.07H:EBX.AVX2, with OS support for ymm state */
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+}
+
+static int cpu_has_ssse3(void)
+{
+        /* CPUID.01H:ECX.SSSE3 */
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("ssse3");
+}
+
+/*
+ * convert left-justified ecc words to 128-bit pairs of 64-bit limbs, least
+ * significant pair first
+ */
+static void ecc_to_pairs(struct bch_control *bch, const uint32_t *ecc,
+                         uint64_t *dst)
+{
+        const unsigned int l = BCH_ECC_WORDS(bch)-1;
+        const unsigned int np = BCH_ECC_PAIRS(bch);
+        unsigned int i, j;
+
+        for (j = 0; j < 2*np; j++) {
+                i = 2*(2*np-1-j);
+                dst[j] = ((uint64_t)((i <= l) ? ecc[i] : 0) << 32)|
+                        ((i+1 <= l) ? ecc[i+1] : 0);
+        }
+}
+
+/*
+ * same as encode_bch(), but process @nchunks 128-bit data chunks using
+ * carry-less multiplication, for @ways independent codewords in lockstep
  *
- * The exact number of computed ecc parity bits is given by member @ecc_bits of
- * @bch; it may be less than m*t for large values of t.
+ * With D = 128*np >= deg(g) and s = D-deg(g), remainder r(X) is kept as
+ * a(X) = r(X).X^s (i.e. left-justified), a polynomial of degree < D+128 stored
+ * in np+1 pairs of limbs. Each chunk c(X) is processed as
+ * a(X) <- a(X).X^128+c(X).X^D, and the overflowing top pair h1.X^64+h0 is
+ * folded back into the remainder by adding h0.K0+h1.K1, where
+ * K0 = X^(D+128) mod g(X).X^s and K1 = X^(D+192) mod g(X).X^s, as in CRC
+ * folding. In order to avoid moving all limbs at each step, the remainder
+ * lives in a window sliding down a scratch buffer.
  */
-void encode_bch(struct bch_control *bch, const uint8_t *data,
-                unsigned int len, uint8_t *ecc)
+__attribute__((target("pclmul,sse2")))
+static BCH_ALWAYS_INLINE void encode_bch_clmul_ways(struct bch_control *bch,
+                                         const uint8_t * const *data,
+                                         unsigned int nchunks,
+                                         uint32_t * const *ecc,
+                                         const unsigned int ways)
+{
+        const unsigned int l = BCH_ECC_WORDS(bch)-1;
+        const unsigned int np = BCH_ECC_PAIRS(bch);
+        const __m128i *k = (const __m128i *)bch->clmul_k;
+        __m128i buf[ways][np+BCH_CLMUL_BLOCK], *a[ways], h[ways], top[ways];
+        __m128i e, o, k0, k1, carry[ways];
+        const uint8_t *d[ways];
+        const uint32_t *p0, *p1, *p2, *p3;
+        uint64_t c[2], limbs[2*np+2];
+        uint32_t tmp[l+1], x;
+        unsigned int i, j, n, p, w;
+
+        /* pairs a[0..np-1] live in memory, top pair a[np] in a register */
+        for (w = 0; w < ways; w++) {
+                d[w] = data[w];
+                a[w] = buf[w]+BCH_CLMUL_BLOCK;
+                ecc_to_pairs(bch, ecc[w], limbs);
+                for (p = 0; p < np; p++)
+                        a[w][p] = _mm_set_epi64x(limbs[2*p+1], limbs[2*p]);
+                top[w] = _mm_setzero_si128();
+        }
+
+        while (nchunks) {
+                n = (nchunks < BCH_CLMUL_BLOCK) ? nchunks : BCH_CLMUL_BLOCK;
+                nchunks -= n;
+                for (i = 0; i < n; i++) {
+                        for (w = 0; w < ways; w++) {
+                                /* input data is read in big-endian format */
+                                __builtin_memcpy(c, d[w], 16);
+                                d[w] += 16;
+                                h[w] = top[w];
+                                top[w] = _mm_xor_si128(a[w][np-1],
+                                        _mm_set_epi64x(__builtin_bswap64(c[0]),
+                                                       __builtin_bswap64(c[1])));
+                                a[w]--;
+                                a[w][0] = _mm_setzero_si128();
+                                carry[w] = _mm_setzero_si128();
+                        }
+                        /*
+                         * k[2p] (resp. k[2p+1]) holds limb 2p (resp. 2p+1) of
+                         * K0 and K1; even products are aligned on pair p, odd
+                         * products straddle pairs p and p+1
+                         */
+                        for (p = 0; p < np; p++) {
+                                /* constants may not be 16-byte aligned */
+                                k0 = _mm_loadu_si128(k+2*p);
+                                k1 = _mm_loadu_si128(k+2*p+1);
+                                for (w = 0; w < ways; w++) {
+                                        e = _mm_xor_si128(
+                                                _mm_clmulepi64_si128(h[w], k0, 0x00),
+                                                _mm_clmulepi64_si128(h[w], k0, 0x11));
+                                        o = _mm_xor_si128(
+                                                _mm_clmulepi64_si128(h[w], k1, 0x00),
+                                                _mm_clmulepi64_si128(h[w], k1, 0x11));
+                                        a[w][p] = _mm_xor_si128(
+                                                _mm_xor_si128(a[w][p], e),
+                                                _mm_xor_si128(_mm_slli_si128(o, 8),
+                                                              carry[w]));
+                                        carry[w] = _mm_srli_si128(o, 8);
+                                }
+                        }
+                        for (w = 0; w < ways; w++)
+                                top[w] = _mm_xor_si128(top[w], carry[w]);
+                }
+                /* move windows back to the top of the buffer (overlapping) */
+                for (w = 0; w < ways; w++) {
+                        for (p = np; p-- > 0;)
+                                buf[w][BCH_CLMUL_BLOCK+p] = a[w][p];
+                        a[w] = buf[w]+BCH_CLMUL_BLOCK;
+                }
+        }
+
+        for (w = 0; w < ways; w++) {
+                /* store pairs back into ecc words */
+                for (p = 0; p < np; p++)
+                        _mm_storeu_si128((__m128i *)&limbs[2*p], a[w][p]);
+                _mm_storeu_si128((__m128i *)&limbs[2*np], top[w]);
+                for (p = 0; p < 2*np; p++) {
+                        i = 2*(2*np-1-p);
+                        if (i <= l)
+                                ecc[w][i] = limbs[p] >> 32;
+                        if (i+1 <= l)
+                                ecc[w][i+1] = limbs[p] & 0xffffffff;
+                }
+                /*
+                 * reduce top pair h(X) as h(X).X^deg(g) mod g, i.e. encode its
+                 * 4 words starting from a zero remainder
+                 */
+                bch_memset(tmp, 0, sizeof(tmp));
+                for (j = 0; j < 4; j++) {
+                        x = tmp[0]^NATIVE32(limbs[2*np+1-j/2] >>
+                                            (32-32*(j & 1)));
+                        p0 = bch->mod8_tab + (l+1)*(256*0+NATIVE_BYTE(x, 0));
+                        p1 = bch->mod8_tab + (l+1)*(256*1+NATIVE_BYTE(x, 1));
+                        p2 = bch->mod8_tab + (l+1)*(256*2+NATIVE_BYTE(x, 2));
+                        p3 = bch->mod8_tab + (l+1)*(256*3+NATIVE_BYTE(x, 3));
+                        BCH_UNROLL
+                        for (i = 0; i < l; i++)
+                                tmp[i] = tmp[i+1]^p0[i]^p1[i]^p2[i]^p3[i];
+                        tmp[l] = p0[l]^p1[l]^p2[l]^p3[l];
+                }
+                for (i = 0; i <= l; i++)
+                        ecc[w][i] ^= NATIVE32(tmp[i]);
+        }
+}
+
+__attribute__((target("pclmul,sse2")))
+static void encode_bch_clmul(struct bch_control *bch, const uint8_t *data,
+                             unsigned int nchunks, uint32_t *ecc)
+{
+        encode_bch_clmul_ways(bch, &data, nchunks, &ecc, 1);
+}
+
+__attribute__((target("pclmul,sse2")))
+static void encode_bch_clmul_batch(struct bch_control *bch,
+                                   const uint8_t * const *data,
+                                   unsigned int nchunks, uint32_t * const *ecc)
+{
+        encode_bch_clmul_ways(bch, data, nchunks, ecc, BCH_BATCH_WAYS);
+}
+#endif /* BCH_HAVE_CLMUL */
+
+/*
+ * same as encode_bch(), with the remainder kept in @ecc as BCH_ECC_WORDS(bch)
+ * 32-bit words in native representation (see ecc_native())
+ */
+static void encode_bch_native(struct bch_control *bch, const uint8_t *data,
+                              unsigned int len, uint32_t *ecc)
 {
         const unsigned int l = BCH_ECC_WORDS(bch)-1;
         unsigned int i, mlen;
         unsigned long m;
         uint32_t w, r[l+1];
-        const uint32_t * const tab0 = bch->mod8_tab;
-        const uint32_t * const tab1 = tab0 + 256*(l+1);
-        const uint32_t * const tab2 = tab1 + 256*(l+1);
-        const uint32_t * const tab3 = tab2 + 256*(l+1);
+        const uint32_t *tab0, *tab1, *tab2, *tab3;
         const uint32_t *pdata, *p0, *p1, *p2, *p3;
 
-        if (ecc) {
-                /* load ecc parity bytes into internal 32-bit buffer */
-                load_ecc8(bch, bch->ecc_buf, ecc);
-        } else {
-                bch_memset(bch->ecc_buf, 0, sizeof(r));
+        if (!bch->mod8_tab) {
+                /* low-memory encoder, see init_bch_ext() */
+                ecc_native(bch, ecc);
+                encode_bch_compact(bch, data, len, ecc);
+                ecc_native(bch, ecc);
+                return;
+        }
+        tab0 = bch->mod8_tab;
+        tab1 = tab0 + 256*(l+1);
+        tab2 = tab1 + 256*(l+1);
+        tab3 = tab2 + 256*(l+1);
+
+#ifdef BCH_HAVE_CLMUL
+        /* use carry-less multiply backend if available, see init_bch_ext() */
+        if (bch->clmul_k && (len >= BCH_CLMUL_MIN_LEN)) {
+                mlen = len/16;
+                ecc_native(bch, ecc);
+                encode_bch_clmul(bch, data, mlen, ecc);
+                ecc_native(bch, ecc);
+                data += 16*mlen;
+                len  -= 16*mlen;
         }
+#endif
+
+        /* local copy, so that table loads cannot alias remainder stores */
+        for (i = 0; i <= l; i++)
+                r[i] = ecc[i];
 
         /* process first unaligned data bytes */
         m = ((unsigned long)data) & 3;
         if (m) {
                 mlen = (len < (4-m)) ? len : 4-m;
-                encode_bch_unaligned(bch, data, mlen, bch->ecc_buf);
+                encode_bch_unaligned(bch, data, mlen, r);
                 data += mlen;
                 len  -= mlen;
         }
@@ -246,7 +857,6 @@ void encode_bch(struct bch_control *bch, const uint8_t *data,
         mlen  = len/4;
         data += 4*mlen;
         len  -= 4*mlen;
-        bch_memcpy(r, bch->ecc_buf, sizeof(r));
 
         /*
          * split each 32-bit word into 4 polynomials of weight 8 as follows:
@@ -259,30 +869,553 @@ void encode_bch(struct bch_control *bch, const uint8_t *data,
          * xxxxxxxx  00000000  00000000  00000000  mod g = r3 (precomputed)
          * xxxxxxxx  yyyyyyyy  zzzzzzzz  tttttttt  mod g = r0^r1^r2^r3
          */
+        if (bch->enc_words == 4) {
+                encode_bch_slice(bch, pdata, mlen/4, r, 4);
+                pdata += mlen & ~3u;
+                mlen &= 3;
+        } else if (bch->enc_words == 2) {
+                encode_bch_slice(bch, pdata, mlen/2, r, 2);
+                pdata += mlen & ~1u;
+                mlen &= 1;
+        }
         while (mlen--) {
                 /* input data is read in big-endian format */
-                w = r[0]^CPU_TO_BE32(*pdata++);
-                p0 = tab0 + (l+1)*((w >>  0) & 0xff);
-                p1 = tab1 + (l+1)*((w >>  8) & 0xff);
-                p2 = tab2 + (l+1)*((w >> 16) & 0xff);
-                p3 = tab3 + (l+1)*((w >> 24) & 0xff);
+                w = r[0]^NATIVE_DATA32(*pdata++);
+                p0 = tab0 + (l+1)*NATIVE_BYTE(w, 0);
+                p1 = tab1 + (l+1)*NATIVE_BYTE(w, 1);
+                p2 = tab2 + (l+1)*NATIVE_BYTE(w, 2);
+                p3 = tab3 + (l+1)*NATIVE_BYTE(w, 3);
 
+                BCH_UNROLL
                 for (i = 0; i < l; i++)
                         r[i] = r[i+1]^p0[i]^p1[i]^p2[i]^p3[i];
 
                 r[l] = p0[l]^p1[l]^p2[l]^p3[l];
         }
-        bch_memcpy(bch->ecc_buf, r, sizeof(r));
 
         /* process last unaligned bytes */
         if (len)
-                encode_bch_unaligned(bch, data, len, bch->ecc_buf);
+                encode_bch_unaligned(bch, data, len, r);
+
+        for (i = 0; i <= l; i++)
+                ecc[i] = r[i];
+}
+
+/*
+ * same as encode_bch(), with the remainder kept in @ecc as BCH_ECC_WORDS(bch)
+ * left-justified 32-bit words
+ */
+static void encode_bch_words(struct bch_control *bch, const uint8_t *data,
+                             unsigned int len, uint32_t *ecc)
+{
+        ecc_native(bch, ecc);
+        encode_bch_native(bch, data, len, ecc);
+        ecc_native(bch, ecc);
+}
+
+/**
+ * encode_bch - calculate BCH ecc parity of data
+ * @bch:   BCH control structure
+ * @data:  data to encode
+ * @len:   data length in bytes
+ * @ecc:   ecc parity data, must be initialized by caller
+ *
+ * The @ecc parity array is used both as input and output parameter, in order to
+ * allow incremental computations. It should be of the size indicated by member
+ * @ecc_bytes of @bch, and should be initialized to 0 before the first call.
+ *
+ * The exact number of computed ecc parity bits is given by member @ecc_bits of
+ * @bch; it may be less than m*t for large values of t.
+ *
+ * Each call converts @ecc from/to the internal word representation; when a
+ * codeword is fed in many small fragments, see init_bch_encoder() instead.
+ */
+void encode_bch(struct bch_control *bch, const uint8_t *data,
+                unsigned int len, uint8_t *ecc)
+{
+        BCH_FIXED_CALL(bch, encode_bch, (bch, data, len, ecc));
+
+        if (ecc) {
+                /* load ecc parity bytes into internal 32-bit buffer */
+                load_ecc8(bch, bch->ecc_buf, ecc);
+        } else {
+                bch_memset(bch->ecc_buf, 0,
+                           BCH_ECC_WORDS(bch)*sizeof(*bch->ecc_buf));
+        }
+
+        encode_bch_words(bch, data, len, bch->ecc_buf);
 
         /* store ecc parity bytes into original parity buffer */
         if (ecc)
                 store_ecc8(bch, ecc, bch->ecc_buf);
 }
 
+/* largest piece of an encodev_bch() fragment given to the encoder at once */
+#define BCH_IOV_SPLIT_LEN      (1u << 30)
+
+/**
+ * encodev_bch - calculate BCH ecc parity of scattered data
+ * @bch:    BCH control structure
+ * @iov:    array of @iovcnt data fragments
+ * @iovcnt: number of data fragments
+ * @ecc:    ecc parity data, must be initialized by caller
+ *
+ * Same as encode_bch() on the concatenation of the @iov fragments, without
+ * copying them: each fragment is processed in place, starting from the
+ * remainder left by the previous one, with byte-wise processing of unaligned
+ * fragment boundaries.
+ */
+void encodev_bch(struct bch_control *bch, const struct bch_iovec *iov,
+                 unsigned int iovcnt, uint8_t *ecc)
+{
+        const uint8_t *data;
+        unsigned int i;
+        size_t len;
+
+        BCH_FIXED_CALL(bch, encodev_bch, (bch, iov, iovcnt, ecc));
+
+        if (ecc)
+                load_ecc8(bch, bch->ecc_buf, ecc);
+        else
+                bch_memset(bch->ecc_buf, 0,
+                           BCH_ECC_WORDS(bch)*sizeof(*bch->ecc_buf));
+
+        /* keep the remainder native across fragments */
+        ecc_native(bch, bch->ecc_buf);
+        for (i = 0; i < iovcnt; i++) {
+                data = (const uint8_t *)iov[i].iov_base;
+                /* encoder lengths are 32-bit, split larger fragments */
+                for (len = iov[i].iov_len; len > BCH_IOV_SPLIT_LEN;
+                     len -= BCH_IOV_SPLIT_LEN) {
+                        encode_bch_native(bch, data, BCH_IOV_SPLIT_LEN,
+                                          bch->ecc_buf);
+                        data += BCH_IOV_SPLIT_LEN;
+                }
+                encode_bch_native(bch, data, len, bch->ecc_buf);
+        }
+        ecc_native(bch, bch->ecc_buf);
+
+        if (ecc)
+                store_ecc8(bch, ecc, bch->ecc_buf);
+}
+
+/**
+ * encode_bch_init - start a new codeword
+ * @enc:   encoder context
+ * @ecc:   initial ecc parity bytes (as for encode_bch()), or %NULL to start
+ *         from zero
+ */
+void encode_bch_init(struct bch_encoder *enc, const uint8_t *ecc)
+{
+        struct bch_control *bch = enc->bch;
+
+        BCH_FIXED_CALL(bch, encode_bch_init, (enc, ecc));
+        if (ecc) {
+                load_ecc8(bch, enc->ecc_buf, ecc);
+                ecc_native(bch, enc->ecc_buf);
+        } else {
+                bch_memset(enc->ecc_buf, 0,
+                           BCH_ECC_WORDS(bch)*sizeof(*enc->ecc_buf));
+        }
+}
+
+/**
+ * encode_bch_update - feed data to an encoder context
+ * @enc:   encoder context
+ * @data:  data to encode
+ * @len:   data length in bytes
+ *
+ * Successive updates are equivalent to a single encode_bch() call on the
+ * concatenation of their data.
+ */
+void encode_bch_update(struct bch_encoder *enc, const uint8_t *data,
+                       unsigned int len)
+{
+        BCH_FIXED_CALL(enc->bch, encode_bch_update, (enc, data, len));
+
+        encode_bch_native(enc->bch, data, len, enc->ecc_buf);
+}
+
+/**
+ * encode_bch_final - retrieve the ecc parity of an encoder context
+ * @enc:   encoder context
+ * @ecc:   output ecc parity bytes, of size @ecc_bytes of the BCH control
+ *         structure
+ *
+ * The context is left unchanged: more data may still be appended with
+ * encode_bch_update(), or a new codeword started with encode_bch_init().
+ */
+void encode_bch_final(struct bch_encoder *enc, uint8_t *ecc)
+{
+        struct bch_control *bch = enc->bch;
+        uint32_t r[BCH_ECC_WORDS(bch)];
+
+        BCH_FIXED_CALL(bch, encode_bch_final, (enc, ecc));
+        /* the remainder stays native between updates, convert a copy */
+        bch_memcpy(r, enc->ecc_buf, sizeof(r));
+        ecc_native(bch, r);
+        store_ecc8(bch, ecc, r);
+}
+
+/*
+ * process @nwords data words of BCH_BATCH_WAYS independent codewords in
+ * lockstep; each chain is the same as the 32-bit loop of encode_bch(), but
+ * interleaving them lets the cpu overlap the table lookups of one chain with
+ * those of the others. Remainders @r are in native representation.
+ */
+static void encode_bch_interleave(struct bch_control *bch,
+                                  const uint8_t * const *data,
+                                  unsigned int nwords, uint32_t *r)
+{
+        const unsigned int l = BCH_ECC_WORDS(bch)-1;
+        const uint32_t * const tab0 = bch->mod8_tab;
+        const uint32_t * const tab1 = tab0 + 256*(l+1);
+        const uint32_t * const tab2 = tab1 + 256*(l+1);
+        const uint32_t * const tab3 = tab2 + 256*(l+1);
+        const uint32_t *p0[BCH_BATCH_WAYS], *p1[BCH_BATCH_WAYS];
+        const uint32_t *p2[BCH_BATCH_WAYS], *p3[BCH_BATCH_WAYS];
+        const uint8_t *d;
+        unsigned int i, j, k;
+        uint32_t w, *rj;
+
+        for (k = 0; k < nwords; k++) {
+                for (j = 0; j < BCH_BATCH_WAYS; j++) {
+                        /* input data is read in big-endian format */
+                        d = data[j]+4*k;
+                        w = r[j*(l+1)]^LOAD_NATIVE32(d);
+                        p0[j] = tab0 + (l+1)*NATIVE_BYTE(w, 0);
+                        p1[j] = tab1 + (l+1)*NATIVE_BYTE(w, 1);
+                        p2[j] = tab2 + (l+1)*NATIVE_BYTE(w, 2);
+                        p3[j] = tab3 + (l+1)*NATIVE_BYTE(w, 3);
+                }
+                for (j = 0; j < BCH_BATCH_WAYS; j++) {
+                        rj = r+j*(l+1);
+                        BCH_UNROLL
+                        for (i = 0; i < l; i++)
+                                rj[i] = rj[i+1]^p0[j][i]^p1[j][i]^
+                                        p2[j][i]^p3[j][i];
+
+                        rj[l] = p0[j][l]^p1[j][l]^p2[j][l]^p3[j][l];
+                }
+        }
+}
+
+/*
+ * whether encode_bch_ways() is worth using, see encode_bch_batch()
+ */
+static inline int encode_bch_ways_ok(struct bch_control *bch)
+{
+        if (!bch->clmul_k && (BCH_ECC_WORDS(bch) > BCH_BATCH_MAX_WORDS))
+                /* table encoder is bound by table reads, not by latency */
+                return 0;
+        /* low-memory encoders are not interleaved */
+        return bch->mod8_tab != NULL;
+}
+
+/*
+ * update remainders of BCH_BATCH_WAYS buffers @data of @len bytes, stored in
+ * polynomial words at @r (BCH_ECC_WORDS words per buffer)
+ */
+static void encode_bch_ways(struct bch_control *bch,
+                            const uint8_t * const *data, unsigned int len,
+                            uint32_t *r)
+{
+        const unsigned int l = BCH_ECC_WORDS(bch)-1;
+        unsigned int j, done = 0;
+#ifdef BCH_HAVE_CLMUL
+        uint32_t *pr[BCH_BATCH_WAYS];
+
+        if (bch->clmul_k) {
+                for (j = 0; j < BCH_BATCH_WAYS; j++)
+                        pr[j] = r+j*(l+1);
+                done = 16*(len/16);
+                encode_bch_clmul_batch(bch, data, len/16, pr);
+        }
+#endif
+        /* table-driven steps work on native words */
+        for (j = 0; j < BCH_BATCH_WAYS; j++)
+                ecc_native(bch, r+j*(l+1));
+        if (done == 0) {
+                done = 4*(len/4);
+                encode_bch_interleave(bch, data, len/4, r);
+        }
+        for (j = 0; j < BCH_BATCH_WAYS; j++) {
+                /* process last unaligned bytes */
+                encode_bch_unaligned(bch, data[j]+done, len-done, r+j*(l+1));
+                ecc_native(bch, r+j*(l+1));
+        }
+}
+
+/**
+ * encode_bch_batch - calculate BCH ecc parity of several data buffers
+ * @bch:   BCH control structure
+ * @data:  array of @count data buffers to encode
+ * @len:   length in bytes of each data buffer
+ * @ecc:   array of @count ecc parity buffers, must be initialized by caller
+ * @count: number of buffers
+ *
+ * This is equivalent to calling encode_bch(@bch, @data[i], @len, @ecc[i]) for
+ * i=0..@count-1 (in particular, @ecc buffers are used both as input and
+ * output), but encodes BCH_BATCH_WAYS buffers at a time with interleaved
+ * remainder computations, which hides most of the table lookup (or carry-less
+ * multiply) latency of a single stream. With the table encoder, this is only
+ * done for ecc sizes up to BCH_BATCH_MAX_WORDS words; beyond that, throughput
+ * is bound by table reads and buffers are encoded one at a time.
+ */
+void encode_bch_batch(struct bch_control *bch, const uint8_t * const *data,
+                      unsigned int len, uint8_t * const *ecc,
+                      unsigned int count)
+{
+        const unsigned int l = BCH_ECC_WORDS(bch)-1;
+        unsigned int i, j, nbatch = encode_bch_ways_ok(bch) ? count : 0;
+        uint32_t r[BCH_BATCH_WAYS][l+1];
+
+        BCH_FIXED_CALL(bch, encode_bch_batch, (bch, data, len, ecc, count));
+
+        for (i = 0; i+BCH_BATCH_WAYS <= nbatch; i += BCH_BATCH_WAYS) {
+                for (j = 0; j < BCH_BATCH_WAYS; j++)
+                        load_ecc8(bch, r[j], ecc[i+j]);
+                encode_bch_ways(bch, data+i, len, r[0]);
+                for (j = 0; j < BCH_BATCH_WAYS; j++)
+                        store_ecc8(bch, ecc[i+j], r[j]);
+        }
+        /* remaining buffers */
+        for (; i < count; i++)
+                encode_bch(bch, data[i], len, ecc[i]);
+}
+
+/*
+ * compare the first ecc_bits bits of remainder @r (polynomial words) with
+ * ecc bytes @ecc, without converting them; returns 1 if they differ
+ */
+static int ecc_differs(struct bch_control *bch, const uint32_t *r,
+                       const uint8_t *ecc)
+{
+        const unsigned int nwords = bch->ecc_bits/32;
+        const unsigned int rem = bch->ecc_bits & 31;
+        unsigned int i, nbits;
+        uint32_t diff = 0;
+
+        for (i = 0; i < nwords; i++)
+                diff |= NATIVE32(r[i])^LOAD_NATIVE32(ecc+4*i);
+
+        /* last bits, in at most 4 bytes */
+        for (i = 0; 8*i < rem; i++) {
+                nbits = (rem-8*i < 8) ? rem-8*i : 8;
+                diff |= ((r[nwords] >> (24-8*i))^ecc[4*nwords+i]) &
+                        (0xff00u >> nbits) & 0xff;
+        }
+
+        return diff != 0;
+}
+
+/**
+ * bch_verify - check whether a received codeword is error-free
+ * @bch:   BCH control structure
+ * @data:  received data
+ * @len:   data length in bytes
+ * @ecc:   received ecc parity bytes
+ *
+ * Returns:
+ *  0 if the codeword has no error, 1 if it has errors, or -EINVAL if @len
+ *  is too large for the code
+ *
+ * This is the first step of decode_bch(@bch, @data, @len, @ecc, NULL, NULL,
+ * errloc) without the others: the ecc of @data is computed with the encoder
+ * word loop and directly compared with @ecc. Dirty codewords still have to be
+ * decoded with decode_bch() to locate errors, if they are correctable.
+ */
+int bch_verify(struct bch_control *bch, const uint8_t *data, unsigned int len,
+               const uint8_t *ecc)
+{
+        uint32_t r[BCH_ECC_WORDS(bch)];
+
+        BCH_FIXED_RETURN(bch, bch_verify, (bch, data, len, ecc));
+
+        if (len > ((bch->n-bch->ecc_bits+7)/8))
+                return -EINVAL;
+
+        bch_memset(r, 0, sizeof(r));
+        encode_bch_words(bch, data, len, r);
+        return ecc_differs(bch, r, ecc);
+}
+
+/**
+ * bch_verify_batch - check whether several received codewords are error-free
+ * @bch:   BCH control structure
+ * @data:  array of @count received data buffers
+ * @len:   length in bytes of each data buffer
+ * @ecc:   array of @count received ecc parity buffers
+ * @count: number of codewords
+ * @dirty: optional output array of @count flags, set to 1 for codewords with
+ *         errors and 0 otherwise
+ *
+ * Returns:
+ *  the number of codewords with errors, or -EINVAL if @len is too large for
+ *  the code
+ *
+ * Same as bch_verify() on each codeword, e.g. the sectors of a NAND page, but
+ * with the interleaved remainder computations of encode_bch_batch().
+ */
+int bch_verify_batch(struct bch_control *bch, const uint8_t * const *data,
+                     unsigned int len, const uint8_t * const *ecc,
+                     unsigned int count, uint8_t *dirty)
+{
+        const unsigned int l = BCH_ECC_WORDS(bch)-1;
+        unsigned int i, j, nbatch = encode_bch_ways_ok(bch) ? count : 0;
+        uint32_t r[BCH_BATCH_WAYS][l+1];
+        int err, ndirty = 0;
+
+        BCH_FIXED_RETURN(bch, bch_verify_batch,
+                         (bch, data, len, ecc, count, dirty));
+
+        if (len > ((bch->n-bch->ecc_bits+7)/8))
+                return -EINVAL;
+
+        for (i = 0; i+BCH_BATCH_WAYS <= nbatch; i += BCH_BATCH_WAYS) {
+                bch_memset(r, 0, sizeof(r));
+                encode_bch_ways(bch, data+i, len, r[0]);
+                for (j = 0; j < BCH_BATCH_WAYS; j++) {
+                        err = ecc_differs(bch, r[j], ecc[i+j]);
+                        if (dirty)
+                                dirty[i+j] = err;
+                        ndirty += err;
+                }
+        }
+        /* remaining codewords */
+        for (; i < count; i++) {
+                err = bch_verify(bch, data[i], len, ecc[i]);
+                if (dirty)
+                        dirty[i] = err;
+                ndirty += err;
+        }
+        return ndirty;
+}
+
+/*
+ * multiply remainder @r (in polynomial representation) by X^(8.2^i) modulo
+ * g(X), where @tab is level i of the BCH_ECC_UPDATE shift tables
+ *
+ * @tab holds the 16 products v(X).X^(8.2^i-pad) mod g(X) of the nibbles of
+ * @r, which are accumulated with Horner's rule from the most significant one;
+ * the pad = 4*nnib-ecc_bits extra X factors of the last shift are cancelled by
+ * the -pad exponent of the table entries
+ */
+static void ecc_shift_mul(struct bch_control *bch, uint32_t *r,
+                          const uint32_t *tab)
+{
+        const unsigned int l = BCH_ECC_WORDS(bch)-1;
+        const unsigned int nnib = DIV_ROUND_UP(bch->ecc_bits, 4);
+        const uint32_t *p, *q;
+        unsigned int i, j;
+        uint32_t acc[l+1];
+
+        bch_memset(acc, 0, sizeof(acc));
+
+        for (j = 0; j < nnib; j++) {
+                /* acc = acc.X^4 mod g + nibble j of r times X^(8.2^i-pad) */
+                p = bch->upd_tab + (l+1)*(acc[0] >> 28);
+                q = tab + (l+1)*((r[j/8] >> (28-4*(j%8))) & 0xf);
+
+                for (i = 0; i < l; i++)
+                        acc[i] = ((acc[i] << 4)|(acc[i+1] >> 28))^p[i]^q[i];
+
+                acc[l] = (acc[l] << 4)^p[l]^q[l];
+        }
+        bch_memcpy(r, acc, sizeof(acc));
+}
+
+/*
+ * number of zero bytes the encoder processes in about the time of one
+ * ecc_shift_mul() call, measured on x86-64 for each encoder; feeding zero bytes
+ * is faster for shorter distances
+ */
+static unsigned int upd_zero_bytes(struct bch_control *bch)
+{
+        const unsigned int nnib = DIV_ROUND_UP(bch->ecc_bits, 4);
+
+        if (bch->clmul_k)
+                return 16*nnib;
+        if (bch->mod8_tab)
+                return 4*nnib;
+        if (bch->mod4_tab)
+                return nnib/2;
+        return 0;
+}
+
+/**
+ * bch_update_ecc - update ecc parity after an in-place rewrite of some data
+ * @bch:      BCH control structure
+ * @ecc:      ecc parity bytes of the old data, updated in place
+ * @len:      total data length in bytes
+ * @offset:   offset in bytes of the rewritten data
+ * @old_data: @n bytes previously stored at @offset
+ * @new_data: @n bytes now stored at @offset
+ * @n:        number of rewritten bytes
+ *
+ * Returns:
+ *  0 on success, or -EINVAL if @offset+@n exceeds @len or @len is too large
+ *  for the code
+ *
+ * Since the code is linear, the ecc of the new data is the old @ecc plus the
+ * ecc of a buffer holding old_data^new_data at @offset and zeroes elsewhere.
+ * The latter is computed by encoding the @n changed bytes and multiplying the
+ * result by X^(8*(@len-@offset-@n)) modulo g(X), i.e. by appending that many
+ * zero bytes.
+ *
+ * When @bch was initialized with the BCH_ECC_UPDATE flag, the multiplication
+ * uses one shift table per bit of the distance, so that the cost is
+ * O(@n + log(@len)) rather than O(@len); otherwise zero bytes are fed to the
+ * encoder.
+ */
+int bch_update_ecc(struct bch_control *bch, uint8_t *ecc, unsigned int len,
+                   unsigned int offset, const uint8_t *old_data,
+                   const uint8_t *new_data, unsigned int n)
+{
+        static const uint8_t zero[256] = {0,};
+        const unsigned int l = BCH_ECC_WORDS(bch)-1;
+        unsigned int i, k, s, mlen;
+        uint32_t r[l+1], e[l+1];
+        uint8_t buf[128];
+
+        BCH_FIXED_RETURN(bch, bch_update_ecc,
+                         (bch, ecc, len, offset, old_data, new_data, n));
+
+        if ((len > ((bch->n-bch->ecc_bits+7)/8)) || (offset > len) ||
+            (n > len-offset))
+                return -EINVAL;
+
+        /* ecc of the changed bytes alone */
+        bch_memset(r, 0, sizeof(r));
+        for (k = 0; k < n; k += mlen) {
+                mlen = (n-k < sizeof(buf)) ? n-k : sizeof(buf);
+                for (i = 0; i < mlen; i++)
+                        buf[i] = old_data[k+i]^new_data[k+i];
+                encode_bch_words(bch, buf, mlen, r);
+        }
+
+        /*
+         * move it to its position, len-offset-n bytes before the end: low bits
+         * of the distance with zero bytes, high bits with shift tables
+         */
+        k = len-offset-n;
+        s = bch->upd_tab ? FLS(upd_zero_bytes(bch)) : 32;
+        for (mlen = (s < 32) ? k & ((1u << s)-1) : k; mlen; ) {
+                i = (mlen < sizeof(zero)) ? mlen : sizeof(zero);
+                encode_bch_words(bch, zero, i, r);
+                mlen -= i;
+        }
+        for (i = s; (i < 32) && (k >> i); i++)
+                if ((k >> i) & 1)
+                        ecc_shift_mul(bch, r, bch->upd_tab+16*(l+1)*(i+1));
+
+        load_ecc8(bch, e, ecc);
+        for (i = 0; i <= l; i++)
+                e[i] ^= r[i];
+        store_ecc8(bch, ecc, e);
+        return 0;
+}
+
 static inline int modulo(struct bch_control *bch, unsigned int v)
 {
         const unsigned int n = GF_N(bch);
@@ -329,6 +1462,16 @@ static inline unsigned int gf_mul(struct bch_control *bch, unsigned int a,
                                                bch->a_log_tab[b])] : 0;
 }
 
+/* same as gf_mul(), without branching on zero operands */
+static inline unsigned int gf_mul_nb(struct bch_control *bch, unsigned int a,
+                                     unsigned int b)
+{
+        const unsigned int mask = -(unsigned int)((a != 0) & (b != 0));
+
+        return bch->a_pow_tab[mod_s(bch, bch->a_log_tab[a]+
+                                    bch->a_log_tab[b])] & mask;
+}
+
 static inline unsigned int gf_sqr(struct bch_control *bch, unsigned int a)
 {
         return a ? bch->a_pow_tab[mod_s(bch, 2*bch->a_log_tab[a])] : 0;
@@ -361,6 +1504,356 @@ static inline int a_ilog(struct bch_control *bch, unsigned int x)
         return mod_s(bch, GF_N(bch)-bch->a_log_tab[x]);
 }
 
+#ifdef BCH_HAVE_CLMUL
+/*
+ * vector syndrome kernels: odd syndrome S = v(a^j) is evaluated with a Horner
+ * scheme over blocks of L = 16 (SSSE3) or 32 (AVX2) bytes, lane k holding
+ * the partial evaluation of bytes k, k+L, k+2L... in GF(2^m), with elements
+ * split into a low byte plane and a high byte plane. Each step multiplies
+ * lanes by the constant a^(8Lj) and adds the table value of the next data
+ * byte; both are linear over GF(2), hence computed with 16-entry pshufb
+ * tables indexed by 4-bit nibbles. Lanes are finally folded into one, lane k
+ * being multiplied by a^(8hj) and added to lane k+h for h = L/2, ..., 2, 1.
+ *
+ * bch->syn_vec holds, per odd syndrome, BCH_SYN_VEC_TABS tables of 16 bytes:
+ *   0-3:  data byte low nibble (low, high plane), high nibble (low, high)
+ *   4+8s: multiplication by a^(8j.2^s), s=0..5, of element nibble k=0..3
+ *         (low, high plane) in tables 4+8s+2k and 4+8s+2k+1
+ */
+#define BCH_SYN_VEC_TABS       (4+8*6)
+
+/*
+ * multiply GF(2^m) elements split into planes @lo and @hi by the constant of
+ * multiplication tables @tab
+ */
+__attribute__((target("ssse3")))
+static BCH_ALWAYS_INLINE void gf_vec_mul(__m128i *lo, __m128i *hi,
+                                         const __m128i *tab)
+{
+        const __m128i mask = _mm_set1_epi8(0x0f);
+        const __m128i n0 = _mm_and_si128(*lo, mask);
+        const __m128i n1 = _mm_and_si128(_mm_srli_epi16(*lo, 4), mask);
+        const __m128i n2 = _mm_and_si128(*hi, mask);
+        const __m128i n3 = _mm_and_si128(_mm_srli_epi16(*hi, 4), mask);
+        __m128i t[8];
+        int k;
+
+        /* tables may not be 16-byte aligned (static heap) */
+        for (k = 0; k < 8; k++)
+                t[k] = _mm_loadu_si128(tab+k);
+
+        *lo = _mm_xor_si128(_mm_xor_si128(_mm_shuffle_epi8(t[0], n0),
+                                          _mm_shuffle_epi8(t[2], n1)),
+                            _mm_xor_si128(_mm_shuffle_epi8(t[4], n2),
+                                          _mm_shuffle_epi8(t[6], n3)));
+        *hi = _mm_xor_si128(_mm_xor_si128(_mm_shuffle_epi8(t[1], n0),
+                                          _mm_shuffle_epi8(t[3], n1)),
+                            _mm_xor_si128(_mm_shuffle_epi8(t[5], n2),
+                                          _mm_shuffle_epi8(t[7], n3)));
+}
+
+__attribute__((target("avx2")))
+static BCH_ALWAYS_INLINE void gf_vec_mul256(__m256i *lo, __m256i *hi,
+                                            const __m256i *tab)
+{
+        const __m256i mask = _mm256_set1_epi8(0x0f);
+        const __m256i n0 = _mm256_and_si256(*lo, mask);
+        const __m256i n1 = _mm256_and_si256(_mm256_srli_epi16(*lo, 4), mask);
+        const __m256i n2 = _mm256_and_si256(*hi, mask);
+        const __m256i n3 = _mm256_and_si256(_mm256_srli_epi16(*hi, 4), mask);
+        __m256i t[8];
+        int k;
+
+        for (k = 0; k < 8; k++)
+                t[k] = _mm256_loadu_si256(tab+k);
+
+        *lo = _mm256_xor_si256(
+                _mm256_xor_si256(_mm256_shuffle_epi8(t[0], n0),
+                                 _mm256_shuffle_epi8(t[2], n1)),
+                _mm256_xor_si256(_mm256_shuffle_epi8(t[4], n2),
+                                 _mm256_shuffle_epi8(t[6], n3)));
+        *hi = _mm256_xor_si256(
+                _mm256_xor_si256(_mm256_shuffle_epi8(t[1], n0),
+                                 _mm256_shuffle_epi8(t[3], n1)),
+                _mm256_xor_si256(_mm256_shuffle_epi8(t[5], n2),
+                                 _mm256_shuffle_epi8(t[7], n3)));
+}
+
+/*
+ * fold 16 lanes @lo/@hi of odd syndrome i into its value; bit u of the byte
+ * of lane 15 has degree @d+u
+ */
+__attribute__((target("ssse3")))
+static BCH_ALWAYS_INLINE unsigned int syndromes_fold(struct bch_control *bch,
+                                                     __m128i lo, __m128i hi,
+                                                     const __m128i *tab,
+                                                     unsigned int i,
+                                                     unsigned int d)
+{
+        __m128i ml, mh;
+        unsigned int v;
+
+#define BCH_SYN_FOLD(_h, _s)                                            \
+        ml = lo;                                                        \
+        mh = hi;                                                        \
+        gf_vec_mul(&ml, &mh, tab+4+8*(_s));                             \
+        lo = _mm_xor_si128(lo, _mm_slli_si128(ml, _h));                 \
+        hi = _mm_xor_si128(hi, _mm_slli_si128(mh, _h))
+
+        BCH_SYN_FOLD(8, 3);
+        BCH_SYN_FOLD(4, 2);
+        BCH_SYN_FOLD(2, 1);
+        BCH_SYN_FOLD(1, 0);
+#undef BCH_SYN_FOLD
+
+        v = ((_mm_cvtsi128_si32(_mm_srli_si128(lo, 15)) & 0xff)|
+             ((_mm_cvtsi128_si32(_mm_srli_si128(hi, 15)) & 0xff) << 8));
+
+        return v ? bch->a_pow_tab[mod_s(bch, a_log(bch, v)+
+                                        modulo(bch, (2*i+1)*d))] : 0;
+}
+
+/*
+ * copy the first, partial block of @len bytes of data, aligned to the end of
+ * a zero-filled block of @lanes bytes (leading zeros do not change syndromes);
+ * returns the number of bytes consumed
+ */
+static unsigned int syndromes_head_block(uint8_t *blk, const uint8_t *data,
+                                         unsigned int len, unsigned int lanes)
+{
+        const unsigned int head = len % lanes;
+
+        bch_memset(blk, 0, lanes);
+        bch_memcpy(blk+lanes-head, data, head);
+        return head;
+}
+
+__attribute__((target("ssse3")))
+static void syndromes_add_bytes_ssse3(struct bch_control *bch,
+                                      const uint8_t *data, unsigned int len,
+                                      unsigned int d, unsigned int *syn)
+{
+        const unsigned int t = GF_T(bch);
+        const __m128i mask = _mm_set1_epi8(0x0f);
+        const __m128i *tab;
+        __m128i x0, x1, lo, hi, v, dt[4];
+        uint8_t blk[16];
+        unsigned int i, k, head;
+
+        head = syndromes_head_block(blk, data, len, 16);
+
+        for (i = 0; i < t; i++) {
+                tab = (const __m128i *)(bch->syn_vec+16*BCH_SYN_VEC_TABS*i);
+                /* tables may not be 16-byte aligned (static heap) */
+                for (k = 0; k < 4; k++)
+                        dt[k] = _mm_loadu_si128(tab+k);
+                lo = _mm_setzero_si128();
+                hi = _mm_setzero_si128();
+                for (k = head ? 0 : 16; k <= len-head; k += 16) {
+                        v = k ? _mm_loadu_si128((const __m128i *)
+                                                (data+head+k-16)) :
+                                _mm_loadu_si128((const __m128i *)blk);
+                        /* lanes = lanes*a^(128j)+v(a^j) */
+                        gf_vec_mul(&lo, &hi, tab+4+8*4);
+                        x0 = _mm_and_si128(v, mask);
+                        x1 = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+                        lo = _mm_xor_si128(lo, _mm_xor_si128(
+                                _mm_shuffle_epi8(dt[0], x0),
+                                _mm_shuffle_epi8(dt[2], x1)));
+                        hi = _mm_xor_si128(hi, _mm_xor_si128(
+                                _mm_shuffle_epi8(dt[1], x0),
+                                _mm_shuffle_epi8(dt[3], x1)));
+                }
+                syn[2*i] ^= syndromes_fold(bch, lo, hi, tab, i, d);
+        }
+}
+
+__attribute__((target("avx2")))
+static void syndromes_add_bytes_avx2(struct bch_control *bch,
+                                     const uint8_t *data, unsigned int len,
+                                     unsigned int d, unsigned int *syn)
+{
+        const unsigned int t = GF_T(bch);
+        const __m256i mask = _mm256_set1_epi8(0x0f);
+        const __m128i *p;
+        __m256i tab[4+8], x0, x1, lo, hi, v;
+        __m128i l0, h0, l1, h1;
+        uint8_t blk[32];
+        unsigned int i, j, k, head;
+
+        head = syndromes_head_block(blk, data, len, 32);
+
+        for (i = 0; i < t; i++) {
+                p = (const __m128i *)(bch->syn_vec+16*BCH_SYN_VEC_TABS*i);
+                /* data tables and multiplication by a^(256j) */
+                for (j = 0; j < 4; j++)
+                        tab[j] = _mm256_broadcastsi128_si256(
+                                _mm_loadu_si128(p+j));
+                for (j = 0; j < 8; j++)
+                        tab[4+j] = _mm256_broadcastsi128_si256(
+                                _mm_loadu_si128(p+4+8*5+j));
+                lo = _mm256_setzero_si256();
+                hi = _mm256_setzero_si256();
+                for (k = head ? 0 : 32; k <= len-head; k += 32) {
+                        v = k ? _mm256_loadu_si256((const __m256i *)
+                                                   (data+head+k-32)) :
+                                _mm256_loadu_si256((const __m256i *)blk);
+                        /* lanes = lanes*a^(256j)+v(a^j) */
+                        gf_vec_mul256(&lo, &hi, tab+4);
+                        x0 = _mm256_and_si256(v, mask);
+                        x1 = _mm256_and_si256(_mm256_srli_epi16(v, 4), mask);
+                        lo = _mm256_xor_si256(lo, _mm256_xor_si256(
+                                _mm256_shuffle_epi8(tab[0], x0),
+                                _mm256_shuffle_epi8(tab[2], x1)));
+                        hi = _mm256_xor_si256(hi, _mm256_xor_si256(
+                                _mm256_shuffle_epi8(tab[1], x0),
+                                _mm256_shuffle_epi8(tab[3], x1)));
+                }
+                /* fold lanes 0-15 into lanes 16-31, times a^(128j) */
+                l0 = _mm256_castsi256_si128(lo);
+                h0 = _mm256_castsi256_si128(hi);
+                l1 = _mm256_extracti128_si256(lo, 1);
+                h1 = _mm256_extracti128_si256(hi, 1);
+                gf_vec_mul(&l0, &h0, p+4+8*4);
+                syn[2*i] ^= syndromes_fold(bch, _mm_xor_si128(l0, l1),
+                                           _mm_xor_si128(h0, h1), p, i, d);
+        }
+}
+#endif /* BCH_HAVE_CLMUL */
+
+/*
+ * add to odd syndromes syn[2i] the evaluation at a^(2i+1) of @len bytes of
+ * @data, using byte-wise tables (see build_syn_tables()); bit u of data[k] is
+ * the coefficient of degree @d+8*(@len-1-k)+u
+ */
+static void syndromes_add_bytes(struct bch_control *bch, const uint8_t *data,
+                                unsigned int len, unsigned int d,
+                                unsigned int *syn)
+{
+        const unsigned int n = GF_N(bch);
+        const unsigned int t = GF_T(bch);
+        const bch_gf_t *tab;
+        unsigned int i, k, e, step, l, sum;
+
+        if (!len)
+                return;
+
+#ifdef BCH_HAVE_CLMUL
+        /* use vector kernels if available, see build_syn_tables() */
+        if (bch->syn_vec && (len >= BCH_SYN_VEC_MIN_LEN)) {
+                if ((bch->syn_lanes == 32) && (len >= BCH_SYN_AVX2_MIN_LEN))
+                        syndromes_add_bytes_avx2(bch, data, len, d, syn);
+                else
+                        syndromes_add_bytes_ssse3(bch, data, len, d, syn);
+                return;
+        }
+#endif
+        for (i = 0; i < t; i++) {
+                tab = bch->syn_tab + 256*i;
+                /* a^(2i+1) exponent of the first byte, and byte stride */
+                e = modulo(bch, (2*i+1)*(d+8*(len-1)));
+                step = modulo(bch, 8*(2*i+1));
+                sum = 0;
+                for (k = 0; k < len; k++) {
+                        l = tab[data[k]];
+                        if (l < n)
+                                sum ^= bch->a_pow_tab[mod_s(bch, l+e)];
+                        e = (e >= step) ? e-step : e+n-step;
+                }
+                syn[2*i] ^= sum;
+        }
+}
+
+/*
+ * add to odd syndromes the evaluation of ecc bytes @ecc8 (ecc_bits bits,
+ * left-justified)
+ */
+static void syndromes_add_ecc8(struct bch_control *bch, const uint8_t *ecc8,
+                               unsigned int *syn)
+{
+        const unsigned int nbytes = DIV_ROUND_UP(bch->ecc_bits, 8);
+        const unsigned int pad = 8*nbytes-bch->ecc_bits;
+        uint8_t last = ecc8[nbytes-1] >> pad;
+
+        /* last byte is shifted to drop its padding bits */
+        syndromes_add_bytes(bch, ecc8, nbytes-1, 8-pad, syn);
+        syndromes_add_bytes(bch, &last, 1, 0, syn);
+}
+
+/*
+ * compute odd syndromes syn[2i] of ecc bytes @ecc8 (ecc_bits bits,
+ * left-justified), for @ways consecutive syndromes starting at @i0: the
+ * remainder is first reduced modulo the minimal polynomial M(X) of a^(2i+1),
+ * a byte at a time, and the residue of degree < deg(M) <= m is then evaluated
+ * at a^(2i+1) with nibble tables, see build_minpoly_tables(). Reductions are
+ * serial table lookups, interleaved for @ways syndromes.
+ */
+static BCH_ALWAYS_INLINE void syndromes_minpoly_ways(struct bch_control *bch,
+                                                     const uint8_t *ecc8,
+                                                     unsigned int *syn,
+                                                     unsigned int i0,
+                                                     const unsigned int ways)
+{
+        const unsigned int nbytes = DIV_ROUND_UP(bch->ecc_bits, 8);
+        const unsigned int pad = 8*nbytes-bch->ecc_bits;
+        const bch_gf_t *tab[ways], *ev;
+        unsigned int w, k, d[ways], mask[ways], r[ways];
+
+        for (w = 0; w < ways; w++) {
+                tab[w] = bch->minpoly_tab+BCH_MINPOLY_TAB_SZ*(i0+w);
+                d[w] = tab[w][0];
+                mask[w] = (1u << d[w])-1;
+                r[w] = 0;
+        }
+        /* r <- (r.X^8+byte) mod M(X) */
+        for (k = 0; k < nbytes-1; k++) {
+                for (w = 0; w < ways; w++) {
+                        r[w] = (r[w] << 8)|ecc8[k];
+                        r[w] = (r[w] & mask[w])^tab[w][1+(r[w] >> d[w])];
+                }
+        }
+        for (w = 0; w < ways; w++) {
+                /* last byte without its padding bits */
+                r[w] = (r[w] << (8-pad))|(ecc8[nbytes-1] >> pad);
+                r[w] = (r[w] & mask[w])^tab[w][1+(r[w] >> d[w])];
+
+                ev = tab[w]+257;
+                syn[2*(i0+w)] = ev[r[w] & 15]^ev[16+((r[w] >> 4) & 15)]^
+                        ev[32+((r[w] >> 8) & 15)]^ev[48+((r[w] >> 12) & 15)];
+#if BCH_GF_NIBBLES > 4
+                syn[2*(i0+w)] ^= ev[64+(r[w] >> 16)];
+#endif
+        }
+}
+
+static void syndromes_minpoly(struct bch_control *bch, const uint8_t *ecc8,
+                              unsigned int *syn)
+{
+        const unsigned int t = GF_T(bch);
+        unsigned int i;
+
+        for (i = 0; i+4 <= t; i += 4)
+                syndromes_minpoly_ways(bch, ecc8, syn, i, 4);
+        for (; i < t; i++)
+                syndromes_minpoly_ways(bch, ecc8, syn, i, 1);
+}
+
+/*
+ * compute even syndromes from odd ones, v(a^(2j)) = v(a^j)^2; returns 0 if all
+ * syndromes are zero
+ */
+static int syndromes_finish(struct bch_control *bch, unsigned int *syn)
+{
+        const unsigned int t = GF_T(bch);
+        unsigned int j, sum = 0;
+
+        for (j = 0; j < t; j++) {
+                syn[2*j+1] = gf_sqr(bch, syn[j]);
+                sum |= syn[2*j];
+        }
+        return sum != 0;
+}
+
 /*
  * compute 2t syndromes of ecc polynomial, i.e. ecc(a^j) for j=1..2t
  */
@@ -380,6 +1873,20 @@ static void compute_syndromes(struct bch_control *bch, uint32_t *ecc,
                 ecc[s/32] &= ~((1u << (32-m))-1);
         bch_memset(syn, 0, 2*t*sizeof(*syn));
 
+        if (bch->minpoly_tab || bch->syn_tab) {
+                /* minimal polynomials or byte-wise tables, see init_bch_ext() */
+                uint8_t ecc8[BCH_ECC_BYTES(bch)];
+
+                store_ecc8(bch, ecc8, ecc);
+                /* prefer vector kernels, then minimal polynomials */
+                if (bch->minpoly_tab && !bch->syn_vec)
+                        syndromes_minpoly(bch, ecc8, syn);
+                else
+                        syndromes_add_ecc8(bch, ecc8, syn);
+                syndromes_finish(bch, syn);
+                return;
+        }
+
         /* compute v(a^j) for j=1 .. 2t-1 */
         do {
                 poly = *ecc++;
@@ -451,8 +1958,143 @@ static int compute_error_locator_polynomial(struct bch_control *bch,
                                 d ^= gf_mul(bch, elp->c[j], syn[2*i+2-j]);
                 }
         }
-        dbg("elp=%s\n", gf_poly_str(elp));
-        return (elp->deg > t) ? -1 : (int)elp->deg;
+        dbg("elp=%s\n", gf_poly_str(elp));
+        return (elp->deg > t) ? -1 : (int)elp->deg;
+}
+
+/*
+ * same as compute_error_locator_polynomial(), with the inversion-less binary
+ * Berlekamp-Massey algorithm (BCH_DEC_IBM):
+ *
+ *   e[i+1](X) = g[i].e[i](X)+d[i].b[i](X)
+ *
+ * where b[i](X) = X^2(i-p).e[p](X) is the shifted copy of the last locator
+ * whose degree increased, and g[i] the discrepancy at that step. Scaling e(X)
+ * by the nonzero g[i] leaves its roots unchanged, so no division is needed.
+ * All t iterations process the t+2 coefficients of e(X) and b(X) with masks
+ * instead of branches, so that the cost only depends on t; e(X) is made monic
+ * by a single inversion at the end.
+ */
+static int compute_error_locator_polynomial_ibm(struct bch_control *bch,
+                                                const unsigned int *syn)
+{
+        const unsigned int t = GF_T(bch);
+        unsigned int i, j, d, g = 1, nb, mask, tmp, deg = 0, bdeg = 1;
+        int k;
+        unsigned int *e = bch->elp->c;
+        unsigned int *b = bch->poly_2t[0]->c;
+
+        bch_memset(e, 0, (t+2)*sizeof(*e));
+        bch_memset(b, 0, (t+2)*sizeof(*b));
+        e[0] = 1;
+        b[1] = 1;
+
+        for (i = 0; i < t; i++) {
+                /* d[i] = e[i].0*S(2i+1)+e[i].1*S(2i)+...+e[i].t*S(2i+1-t) */
+                d = 0;
+                for (j = 0; (j <= t) && (j <= 2*i); j++)
+                        d ^= gf_mul_nb(bch, e[j], syn[2*i-j]);
+
+                /* update b(X) and degrees if the degree of e(X) increases */
+                mask = -(unsigned int)((d != 0) & (bdeg > deg));
+                tmp = (bdeg & mask)|(deg & ~mask);
+                bdeg = ((deg & mask)|(bdeg & ~mask))+2;
+                deg = tmp;
+
+                /* descending k, so that e[k-2] and b[k-2] are still old */
+                for (k = t+1; k >= 0; k--) {
+                        nb = (k < 2) ? 0 :
+                                (e[k-2] & mask)|(b[k-2] & ~mask);
+                        e[k] = gf_mul_nb(bch, g, e[k])^gf_mul_nb(bch, d, b[k]);
+                        b[k] = nb;
+                }
+                g = (d & mask)|(g & ~mask);
+        }
+
+        if (deg > t)
+                return -1;
+
+        /* e[0] is the product of nonzero g values */
+        g = gf_inv(bch, e[0]);
+        for (j = 0; j <= deg; j++)
+                e[j] = gf_mul(bch, g, e[j]);
+        bch->elp->deg = deg;
+        dbg("elp=%s\n", gf_poly_str(bch->elp));
+        return (int)deg;
+}
+
+/*
+ * same as compute_error_locator_polynomial() for t <= 4, solving Peterson's
+ * equations in closed form: for nu = t,...,1 errors, the binary Newton
+ * identities give (S(k) = syn[k-1], e1 = S1)
+ *
+ *   nu=2: e2 = (S3+S1^3)/S1
+ *   nu=3: e2 = (S1^2.S3+S5)/(S3+S1^3),                    e3 = S3+S1^3+S1.e2
+ *   nu=4: e2 = (S1.(S7+S1^7)+S3.(S5+S1^5))/D,             e3 = S3+S1^3+S1.e2
+ *         e4 = (S5+S1^2.S3+(S3+S1^3).e2)/S1 or (S7+S5.e2)/S3 if S1=0
+ *         with D = S3.(S3+S1^3)+S1.(S5+S1^5)
+ *
+ * where the first nu with a nonzero denominator is the number of errors (or
+ * one more, in which case the leading coefficient is zero); the identities
+ * of the syndromes that were not used are then checked, so that the result
+ * is the same as with Berlekamp-Massey
+ */
+static int compute_error_locator_polynomial_small(struct bch_control *bch,
+                                                  const unsigned int *syn)
+{
+        const unsigned int t = GF_T(bch);
+        const unsigned int s1 = syn[0];
+        const unsigned int s3 = (t > 1) ? syn[2] : 0;
+        const unsigned int s5 = (t > 2) ? syn[4] : 0;
+        const unsigned int s7 = (t > 3) ? syn[6] : 0;
+        unsigned int s1_2, s1_3, s1_5, s13, s15, den, d, nu;
+        unsigned int *e = bch->elp->c;
+        int i, j, k;
+
+        bch_memset(e, 0, (t+1)*sizeof(*e));
+        e[0] = 1;
+        e[1] = s1;
+
+        s1_2 = gf_sqr(bch, s1);
+        s1_3 = gf_mul(bch, s1_2, s1);
+        s1_5 = gf_mul(bch, s1_3, s1_2);
+        s13 = s3^s1_3;
+        s15 = s5^s1_5;
+
+        den = (t > 3) ? gf_mul(bch, s3, s13)^gf_mul(bch, s1, s15) : 0;
+        if (den) {
+                e[2] = gf_div(bch, gf_mul(bch, s1, s7^gf_mul(bch, s1_5, s1_2))^
+                              gf_mul(bch, s3, s15), den);
+                e[3] = s13^gf_mul(bch, s1, e[2]);
+                e[4] = s1 ? gf_div(bch, s5^gf_mul(bch, s1_2, s3)^
+                                   gf_mul(bch, s13, e[2]), s1) :
+                        gf_div(bch, s7^gf_mul(bch, s5, e[2]), s3);
+                nu = 4;
+        } else if ((t > 2) && s13) {
+                e[2] = gf_div(bch, gf_mul(bch, s1_2, s3)^s5, s13);
+                e[3] = s13^gf_mul(bch, s1, e[2]);
+                nu = 3;
+        } else if ((t > 1) && s1) {
+                e[2] = gf_div(bch, s13, s1);
+                nu = 2;
+        } else {
+                nu = s1 ? 1 : 0;
+        }
+
+        /* check S(k)+e1.S(k-1)+...+e(nu).S(k-nu) = 0 for odd k > 2.nu-1 */
+        for (k = 2*nu+1; k < (int)(2*t); k += 2) {
+                d = syn[k-1];
+                for (j = 1; j <= (int)nu; j++)
+                        d ^= gf_mul(bch, e[j], syn[k-j-1]);
+                if (d)
+                        return -1;
+        }
+
+        for (i = nu; (i > 0) && !e[i]; i--)
+                ;
+        bch->elp->deg = i;
+        dbg("elp=%s\n", gf_poly_str(bch->elp));
+        return i;
 }
 
 /*
@@ -541,7 +2183,9 @@ static int find_affine4_roots(struct bch_control *bch, unsigned int a,
 {
         int i, j, k;
         const int m = GF_M(bch);
-        unsigned int mask = 0xff, t, rows[16] = {0,};
+        /* m+1 rows of m+1 bits, transposed as a 16x16 or 32x32 matrix */
+        const int w = (m < 16) ? 16 : 32;
+        unsigned int mask = (1u << (w/2))-1, t, rows[32] = {0,};
 
         j = a_log(bch, b);
         k = a_log(bch, a);
@@ -555,12 +2199,9 @@ static int find_affine4_roots(struct bch_control *bch, unsigned int a,
                 j++;
                 k += 2;
         }
-        /*
-         * transpose 16x16 matrix before passing it to linear solver
-         * warning: this code assumes m < 16
-         */
-        for (j = 8; j != 0; j >>= 1, mask ^= (mask << j)) {
-                for (k = 0; k < 16; k = (k+j+1) & ~j) {
+        /* transpose matrix before passing it to linear solver */
+        for (j = w/2; j != 0; j >>= 1, mask ^= (mask << j)) {
+                for (k = 0; k < w; k = (k+j+1) & ~j) {
                         t = ((rows[k] >> j)^rows[k+j]) & mask;
                         rows[k] ^= (t << j);
                         rows[k+j] ^= t;
@@ -569,6 +2210,90 @@ static int find_affine4_roots(struct bch_control *bch, unsigned int a,
         return solve_linear_system(bch, rows, roots, 4);
 }
 
+/*
+ * BCH_DEC_ROOT_TABLES: find a root z of Z^2+bZ+c (b != 0), the other root being
+ * z+b; returns 0 if there is none
+ */
+static int find_deg2_root_tab(struct bch_control *bch, unsigned int b,
+                              unsigned int c, unsigned int *z)
+{
+        unsigned int w;
+
+        if (c == 0) {
+                *z = 0;
+                return 1;
+        }
+        /* using Z=bW, transform into W^2+W+c/b^2 */
+        w = bch->deg2_tab[gf_div(bch, c, gf_sqr(bch, b))];
+        if (!w)
+                return 0;
+        *z = gf_mul(bch, b, w);
+        return 1;
+}
+
+/*
+ * BCH_DEC_ROOT_TABLES: find the roots of Y^3+pY+q; returns 3, or 0 unless it
+ * has 3 distinct roots
+ */
+static int find_deg3_depressed_roots_tab(struct bch_control *bch,
+                                         unsigned int p, unsigned int q,
+                                         unsigned int *roots)
+{
+        const unsigned int n = GF_N(bch);
+        unsigned int l, s, z, z2;
+
+        if (q == 0)
+                /* Y(Y^2+p) has a double root */
+                return 0;
+        if (p == 0) {
+                /* Y^3 = q has 3 roots iff 3 divides both n and log(q) */
+                l = a_log(bch, q);
+                if ((n % 3) || (l % 3))
+                        return 0;
+                roots[0] = a_pow(bch, l/3);
+                roots[1] = a_pow(bch, l/3+n/3);
+                roots[2] = a_pow(bch, l/3+2*n/3);
+                return 3;
+        }
+        /* using Y=sZ with s^2=p, transform into Z^3+Z+q/s^3 */
+        l = a_log(bch, p);
+        l = (l+((l & 1) ? n : 0))/2;
+        s = a_pow(bch, l);
+        z = bch->deg3_tab[gf_div(bch, q, a_pow(bch, 3*l))];
+        /* then Z^3+Z+z^3+z = (Z+z)(Z^2+zZ+z^2+1) */
+        if (!z || !find_deg2_root_tab(bch, z, gf_sqr(bch, z)^1, &z2))
+                return 0;
+        roots[0] = gf_mul(bch, s, z);
+        roots[1] = gf_mul(bch, s, z2);
+        roots[2] = gf_mul(bch, s, z2^z);
+        return 3;
+}
+
+/*
+ * BCH_DEC_ROOT_TABLES: same as find_affine4_roots(), without a linear system.
+ * The kernel of the linear map L(Y) = Y^4+aY^2+bY is {0,k1,k2,k3}, where the
+ * ki are the roots of Y^3+aY+b, and L(Y) = M(N(Y)) with N(Y) = Y^2+k1.Y and
+ * M(Z) = Z^2+k2.k3.Z; roots of L(Y) = c are y, y+k1, y+k2, y+k3 where
+ * M(z) = c and N(y) = z.
+ */
+static int find_affine4_roots_tab(struct bch_control *bch, unsigned int a,
+                                  unsigned int b, unsigned int c,
+                                  unsigned int *roots)
+{
+        unsigned int k[3], y, z;
+
+        if ((find_deg3_depressed_roots_tab(bch, a, b, k) != 3) ||
+            !find_deg2_root_tab(bch, gf_mul(bch, k[1], k[2]), c, &z) ||
+            !find_deg2_root_tab(bch, k[0], z, &y))
+                return 0;
+
+        roots[0] = y;
+        roots[1] = y^k[0];
+        roots[2] = y^k[1];
+        roots[3] = y^k[2];
+        return 4;
+}
+
 /*
  * compute root r of a degree 1 polynomial over GF(2^m) (returned as log(1/r))
  */
@@ -590,7 +2315,7 @@ static int find_poly_deg1_roots(struct bch_control *bch, struct gf_poly *poly,
 static int find_poly_deg2_roots(struct bch_control *bch, struct gf_poly *poly,
                                 unsigned int *roots)
 {
-        int n = 0, i, l0, l1, l2;
+        int n = 0, i, l0, l1, l2, found;
         unsigned int u, v, r;
 
         if (poly->c[0] && poly->c[1]) {
@@ -607,15 +2332,22 @@ static int find_poly_deg2_roots(struct bch_control *bch, struct gf_poly *poly,
                  * u + sum(li.Tr(a^i).a^k) = u+a^k.Tr(sum(li.a^i)) = u+a^k.Tr(u)
                  * i.e. r and r+1 are roots iff Tr(u)=0
                  */
-                r = 0;
-                v = u;
-                while (v) {
-                        i = deg(v);
-                        r ^= bch->xi_tab[i];
-                        v ^= (1 << i);
+                if (bch->deg2_tab) {
+                        /* direct lookup, 0 if Tr(u)=1 */
+                        r = bch->deg2_tab[u];
+                        found = (r != 0);
+                } else {
+                        r = 0;
+                        v = u;
+                        while (v) {
+                                i = deg(v);
+                                r ^= bch->xi_tab[i];
+                                v ^= (1 << i);
+                        }
+                        /* verify root */
+                        found = ((gf_sqr(bch, r)^r) == u);
                 }
-                /* verify root */
-                if ((gf_sqr(bch, r)^r) == u) {
+                if (found) {
                         /* reverse z=a/bX transformation and compute log(1/r) */
                         roots[n++] = modulo(bch, 2*GF_N(bch)-l1-
                                             bch->a_log_tab[r]+l2);
@@ -647,8 +2379,16 @@ static int find_poly_deg3_roots(struct bch_control *bch, struct gf_poly *poly,
                 b = gf_mul(bch, a2, b2)^c2;        /* b = a2b2 + c2 */
                 a = gf_sqr(bch, a2)^b2;            /* a = a2^2 + b2 */
 
-                /* find the 4 roots of this affine polynomial */
-                if (find_affine4_roots(bch, a, b, c, tmp) == 4) {
+                if (bch->deg3_tab) {
+                        /*
+                         * a, b are also the coefficients of the depressed
+                         * cubic Y^3+aY+b, with Y = X+a2
+                         */
+                        if (find_deg3_depressed_roots_tab(bch, a, b,
+                                                          tmp) == 3)
+                                for (i = 0; i < 3; i++)
+                                        roots[n++] = a_ilog(bch, tmp[i]^a2);
+                } else if (find_affine4_roots(bch, a, b, c, tmp) == 4) {
                         /* remove a2 from final list of roots */
                         for (i = 0; i < 4; i++) {
                                 if (tmp[i] != a2)
@@ -712,7 +2452,8 @@ static int find_poly_deg4_roots(struct bch_control *bch, struct gf_poly *poly,
                 a2 = b;
         }
         /* find the 4 roots of this affine polynomial */
-        if (find_affine4_roots(bch, a2, b2, c2, roots) == 4) {
+        if ((bch->deg3_tab ? find_affine4_roots_tab(bch, a2, b2, c2, roots) :
+             find_affine4_roots(bch, a2, b2, c2, roots)) == 4) {
                 for (i = 0; i < 4; i++) {
                         /* post-process roots (reverse transformations) */
                         f = a ? gf_inv(bch, roots[i]) : roots[i];
@@ -736,6 +2477,175 @@ static void gf_poly_logrep(struct bch_control *bch,
                 rep[i] = a->c[i] ? mod_s(bch, a_log(bch, a->c[i])+l) : -1;
 }
 
+#ifdef BCH_HAVE_CLMUL
+/*
+ * vector polynomial remainder kernels, both computing the product of divisor
+ * coefficients by the constant c[j] of each elimination step 4 or 8 lanes at
+ * a time:
+ *
+ * - row tables (SSE2): bch->mod_tab holds, for a monic divisor r of degree d,
+ *   16 rows of t words per element nibble; row 16k+b is the product of r by
+ *   the field element b.2^(4k), so that eliminating a leading term c amounts
+ *   to xoring the rows selected by the nibbles of c, with no log or exponent
+ *   lookup. Rows
+ *   are worth building for repeated divisions by the same polynomial, i.e.
+ *   the m squarings of compute_trace_basis(); the few steps of each division
+ *   of gf_poly_gcd() do not amortize them.
+ *
+ * - gathers (AVX2): log additions and reductions are lane-wise, exponent
+ *   lookups are gathered; this needs no setup, and pays off for divisors of
+ *   degree at least BCH_MOD_GATHER_MIN_DEG.
+ */
+#define BCH_MOD_TAB_ROWS       (16*BCH_GF_NIBBLES)
+#define BCH_MOD_GATHER_MIN_DEG 16
+
+/*
+ * build row tables of polynomial b, whose monic log-based representation is
+ * @rep
+ */
+static void gf_poly_mod_tab_build(struct bch_control *bch,
+                                  const struct gf_poly *b, const int *rep)
+{
+        const unsigned int m = GF_M(bch), t = GF_T(bch), d = b->deg;
+        const unsigned int poly = (1u << m)|bch->a_pow_tab[m];
+        uint32_t *tab = bch->mod_tab, *row, v;
+        unsigned int i, u, k, nb, lim;
+
+        /* row of bit u: a^u.r, computed by successive multiplications by a */
+        for (i = 0; i < d; i++) {
+                v = (rep[i] >= 0) ? bch->a_pow_tab[rep[i]] : 0;
+                for (u = 0; u < m; u++) {
+                        tab[(16*(u/4)+(1u << (u%4)))*t+i] = v;
+                        v <<= 1;
+                        if (v >> m)
+                                v ^= poly;
+                }
+        }
+        /* other rows by linearity; rows of values >= 2^m are never used */
+        for (k = 0; k < BCH_GF_NIBBLES; k++) {
+                bch_memset(tab+16*k*t, 0, d*sizeof(*tab));
+                lim = (m >= 4*k+4) ? 16 : (m > 4*k) ? 1u << (m-4*k) : 1;
+                for (nb = 3; nb < lim; nb++) {
+                        if (!(nb & (nb-1)))
+                                continue;
+                        row = tab+(16*k+nb)*t;
+                        for (i = 0; i < d; i++)
+                                row[i] = tab[(16*k+(nb & (nb-1)))*t+i]^
+                                        tab[(16*k+(nb & -nb))*t+i];
+                }
+        }
+}
+
+/*
+ * compute a mod b, b being the polynomial of the current row tables
+ */
+static void gf_poly_mod_tab(struct bch_control *bch, struct gf_poly *a,
+                            const struct gf_poly *b)
+{
+        const unsigned int t = GF_T(bch), d = b->deg;
+        const uint32_t *tab = bch->mod_tab, *r0, *r1, *r2, *r3;
+        unsigned int i, j, v, *p, *c = a->c;
+        __m128i x;
+#if BCH_GF_NIBBLES > 4
+        const uint32_t *r4;
+#endif
+
+        if (a->deg < d)
+                return;
+
+        for (j = a->deg; j >= d; j--) {
+                v = c[j];
+                if (v) {
+                        p = c+j-d;
+                        r0 = tab+(v & 15)*t;
+                        r1 = tab+(16+((v >> 4) & 15))*t;
+                        r2 = tab+(32+((v >> 8) & 15))*t;
+                        r3 = tab+(48+((v >> 12) & 15))*t;
+#if BCH_GF_NIBBLES > 4
+                        r4 = tab+(64+(v >> 16))*t;
+#endif
+                        for (i = 0; i+4 <= d; i += 4) {
+                                x = _mm_xor_si128(
+                                        _mm_xor_si128(
+                                          _mm_loadu_si128((void *)(r0+i)),
+                                          _mm_loadu_si128((void *)(r1+i))),
+                                        _mm_xor_si128(
+                                          _mm_loadu_si128((void *)(r2+i)),
+                                          _mm_loadu_si128((void *)(r3+i))));
+                                x = _mm_xor_si128(x, _mm_loadu_si128(
+                                                          (void *)(p+i)));
+#if BCH_GF_NIBBLES > 4
+                                x = _mm_xor_si128(x, _mm_loadu_si128(
+                                                          (void *)(r4+i)));
+#endif
+                                _mm_storeu_si128((void *)(p+i), x);
+                        }
+                        for (; i < d; i++) {
+                                p[i] ^= r0[i]^r1[i]^r2[i]^r3[i];
+#if BCH_GF_NIBBLES > 4
+                                p[i] ^= r4[i];
+#endif
+                        }
+                }
+        }
+        a->deg = d-1;
+        while (!c[a->deg] && a->deg)
+                a->deg--;
+}
+
+/*
+ * compute a mod b, monic log-based representation of b being @rep
+ */
+__attribute__((target("avx2")))
+static void gf_poly_mod_avx2(struct bch_control *bch, struct gf_poly *a,
+                             const struct gf_poly *b, const int *rep)
+{
+        const unsigned int d = b->deg;
+        const __m256i n = _mm256_set1_epi32(GF_N(bch));
+        const __m256i n1 = _mm256_set1_epi32(GF_N(bch)-1);
+        const __m256i none = _mm256_set1_epi32(-1);
+        const __m256i mask = _mm256_set1_epi32((bch_gf_t)~0u);
+        const int *pow = (const int *)bch->a_pow_tab;
+        unsigned int i, j, *p, *c = a->c;
+        __m256i r, l, valid, x;
+        int la;
+
+        for (j = a->deg; j >= d; j--) {
+                if (c[j]) {
+                        la = a_log(bch, c[j]);
+                        l = _mm256_set1_epi32(la);
+                        p = c+j-d;
+                        for (i = 0; i+8 <= d; i += 8) {
+                                r = _mm256_loadu_si256((const void *)(rep+i));
+                                valid = _mm256_cmpgt_epi32(r, none);
+                                /* mod_s(rep[i]+la) */
+                                r = _mm256_add_epi32(r, l);
+                                r = _mm256_sub_epi32(r, _mm256_and_si256(
+                                        _mm256_cmpgt_epi32(r, n1), n));
+                                /*
+                                 * 16-bit entries are read as 32-bit words:
+                                 * the table has n+1 entries, and r < n
+                                 */
+                                x = _mm256_mask_i32gather_epi32(
+                                        _mm256_setzero_si256(), pow, r, valid,
+                                        sizeof(bch_gf_t));
+                                x = _mm256_and_si256(x, mask);
+                                x = _mm256_xor_si256(x, _mm256_loadu_si256(
+                                                        (const void *)(p+i)));
+                                _mm256_storeu_si256((void *)(p+i), x);
+                        }
+                        for (; i < d; i++)
+                                if (rep[i] >= 0)
+                                        p[i] ^= bch->a_pow_tab[mod_s(bch,
+                                                                     rep[i]+la)];
+                }
+        }
+        a->deg = d-1;
+        while (!c[a->deg] && a->deg)
+                a->deg--;
+}
+#endif /* BCH_HAVE_CLMUL */
+
 /*
  * compute polynomial Euclidean division remainder in GF(2^m)[X]
  */
@@ -755,6 +2665,12 @@ static void gf_poly_mod(struct bch_control *bch, struct gf_poly *a,
                 gf_poly_logrep(bch, b, rep);
         }
 
+#ifdef BCH_HAVE_CLMUL
+        if (bch->mod_avx2 && (d >= BCH_MOD_GATHER_MIN_DEG)) {
+                gf_poly_mod_avx2(bch, a, b, rep);
+                return;
+        }
+#endif
         for (j = a->deg; j >= d; j--) {
                 if (c[j]) {
                         la = a_log(bch, c[j]);
@@ -812,6 +2728,9 @@ static struct gf_poly *gf_poly_gcd(struct bch_control *bch, struct gf_poly *a,
                 b = a;
                 a = tmp;
         }
+        /* a nonzero constant remainder means coprime polynomials */
+        if (b->c[0])
+                a = b;
 
         dbg("%s\n", gf_poly_str(a));
 
@@ -819,157 +2738,535 @@ static struct gf_poly *gf_poly_gcd(struct bch_control *bch, struct gf_poly *a,
 }
 
 /*
- * Given a polynomial f and an integer k, compute Tr(a^kX) mod f
- * This is used in Berlekamp Trace algorithm for splitting polynomials
+ * Given a polynomial f, compute X^(2^i) mod f for i=0..m-1 into bch->btz_basis
+ * (log representation, -1 for zero terms, rows of deg(f) terms), so that
+ * Tr(a^kX) mod f = sum(a^(k.2^i).(X^(2^i) mod f)) can then be computed for any
+ * k without polynomial squaring and reduction
  */
-static void compute_trace_bk_mod(struct bch_control *bch, int k,
-                                 const struct gf_poly *f, struct gf_poly *z,
-                                 struct gf_poly *out)
+static void compute_trace_basis(struct bch_control *bch,
+                                const struct gf_poly *f, struct gf_poly *z)
 {
         const int m = GF_M(bch);
-        int i, j;
+        const int d = f->deg;
+        int i, j, *row;
 
-        /* z contains z^2j mod f */
         z->deg = 1;
         z->c[0] = 0;
-        z->c[1] = bch->a_pow_tab[k];
+        z->c[1] = 1;
 
-        out->deg = 0;
-        bch_memset(out, 0, GF_POLY_SZ(f->deg));
-
-        /* compute f log representation only once */
+        /* compute f log representation and row tables only once */
         gf_poly_logrep(bch, f, bch->cache);
+#ifdef BCH_HAVE_CLMUL
+        if (bch->mod_tab)
+                gf_poly_mod_tab_build(bch, f, bch->cache);
+#endif
 
         for (i = 0; i < m; i++) {
-                /* add a^(k*2^i)(z^(2^i) mod f) and compute (z^(2^i) mod f)^2 */
-                for (j = z->deg; j >= 0; j--) {
-                        out->c[j] ^= z->c[j];
-                        z->c[2*j] = gf_sqr(bch, z->c[j]);
-                        z->c[2*j+1] = 0;
-                }
-                if (z->deg > out->deg)
-                        out->deg = z->deg;
-
+                row = bch->btz_basis+i*GF_T(bch);
+                for (j = 0; j < d; j++)
+                        row[j] = ((j <= (int)z->deg) && z->c[j]) ?
+                                a_log(bch, z->c[j]) : -1;
                 if (i < m-1) {
-                        z->deg *= 2;
                         /* z^(2(i+1)) mod f = (z^(2^i) mod f)^2 mod f */
+                        for (j = z->deg; j >= 0; j--) {
+                                z->c[2*j] = gf_sqr(bch, z->c[j]);
+                                z->c[2*j+1] = 0;
+                        }
+                        z->deg *= 2;
+#ifdef BCH_HAVE_CLMUL
+                        if (bch->mod_tab) {
+                                gf_poly_mod_tab(bch, z, f);
+                                continue;
+                        }
+#endif
                         gf_poly_mod(bch, z, f, bch->cache);
                 }
         }
-        while (!out->c[out->deg] && out->deg)
-                out->deg--;
+}
+
+/*
+ * Given an integer k, compute the @d coefficients of Tr(a^kX) mod f, where f
+ * is the degree @d polynomial passed to compute_trace_basis()
+ */
+static void compute_trace_bk_mod(struct bch_control *bch, int k, int d,
+                                 unsigned int *out)
+{
+        const int m = GF_M(bch);
+        const int *row;
+        int i, j, l;
+
+        bch_memset(out, 0, d*sizeof(*out));
 
-        dbg("Tr(a^%d.X) mod f = %s\n", k, gf_poly_str(out));
+        for (i = 0; i < m; i++) {
+                /* add a^(k*2^i)(X^(2^i) mod f) */
+                l = modulo(bch, k << i);
+                row = bch->btz_basis+i*GF_T(bch);
+                for (j = 0; j < d; j++)
+                        if (row[j] >= 0)
+                                out[j] ^= bch->a_pow_tab[mod_s(bch, row[j]+l)];
+        }
 }
 
 /*
- * factor a polynomial using Berlekamp Trace algorithm (BTA)
+ * factor a polynomial using Berlekamp Trace algorithm (BTA), trying Tr(a^kX)
+ * for k = *k..m; on success, *k is the value that split the polynomial and *h
+ * is not NULL
+ *
+ * f divides the degree @d polynomial of the trace basis, hence Tr(a^kX) mod f
+ * is obtained by reducing Tr(a^kX) mod basis polynomial, which is computed once
+ * per k into bch->btz_trace and flagged in @traces; sibling factors, which
+ * are split with the same k, share it.
  */
-static void factor_polynomial(struct bch_control *bch, int k, struct gf_poly *f,
+static void factor_polynomial(struct bch_control *bch, unsigned int *k, int d,
+                              unsigned int *traces, struct gf_poly *f,
                               struct gf_poly **g, struct gf_poly **h)
 {
         struct gf_poly *f2 = bch->poly_2t[0];
         struct gf_poly *q  = bch->poly_2t[1];
         struct gf_poly *tk = bch->poly_2t[2];
-        struct gf_poly *z  = bch->poly_2t[3];
         struct gf_poly *gcd;
+        unsigned int *trace;
 
         dbg("factoring %s...\n", gf_poly_str(f));
 
         *g = f;
         *h = NULL;
 
-        /* tk = Tr(a^k.X) mod f */
-        compute_trace_bk_mod(bch, k, f, z, tk);
+        for (; *k <= GF_M(bch); (*k)++) {
+                trace = bch->btz_trace+(*k-1)*GF_T(bch);
+                if (!(*traces & (1u << (*k-1)))) {
+                        compute_trace_bk_mod(bch, *k, d, trace);
+                        *traces |= 1u << (*k-1);
+                }
+                /* tk = Tr(a^k.X) mod f */
+                bch_memcpy(tk->c, trace, d*sizeof(*trace));
+                tk->deg = d-1;
+                while (!tk->c[tk->deg] && tk->deg)
+                        tk->deg--;
+                gf_poly_mod(bch, tk, f, NULL);
+                dbg("Tr(a^%d.X) mod f = %s\n", *k, gf_poly_str(tk));
+                if (tk->deg == 0)
+                        continue;
+
+                /* compute g = gcd(f, tk) (destructive operation) */
+                gf_poly_copy(f2, f);
+                gcd = gf_poly_gcd(bch, f2, tk);
+                if ((gcd->deg > 0) && (gcd->deg < f->deg)) {
+                        /* compute h=f/gcd(f,tk); this will modify f and q */
+                        gf_poly_div(bch, f, gcd, q);
+                        /* store g and h in-place (clobbering f) */
+                        *h = &((struct gf_poly_deg1 *)f)[gcd->deg].poly;
+                        gf_poly_copy(*g, gcd);
+                        gf_poly_copy(*h, q);
+                        return;
+                }
+        }
+}
+
+/*
+ * find roots of a polynomial, using BTZ algorithm; see the beginning of this
+ * file for details
+ *
+ * Factors are split in place within @poly and solved depth-first from the work
+ * stack bch->btz_stack: since pending factors are disjoint factors of @poly,
+ * each of degree at least 1, the stack never holds more than deg(@poly) <= t
+ * entries. The trace basis of @poly is computed once, and serves all factors.
+ *
+ * Roots are raw error locations, only the first @nbits of which belong to a
+ * (shortened) codeword. The search fails with -1 as soon as a root falls
+ * outside of the codeword, or a factor is found not to split into distinct
+ * roots: in both cases the codeword is uncorrectable, and the remaining
+ * factors need not be solved.
+ */
+static int find_poly_roots(struct bch_control *bch, unsigned int k,
+                           struct gf_poly *poly, unsigned int *roots,
+                           unsigned int nbits)
+{
+        struct btz_item *stack = bch->btz_stack;
+        struct gf_poly *f, *f1, *f2;
+        unsigned int sp = 0, traces = 0;
+        const int d = poly->deg;
+        int i, cnt, n = 0;
+
+        /* all factors divide poly: share its trace basis */
+        if (d > 4)
+                compute_trace_basis(bch, poly, bch->poly_2t[3]);
+
+        stack[sp].f = poly;
+        stack[sp++].k = k;
+
+        while (sp) {
+                sp--;
+                f = stack[sp].f;
+                k = stack[sp].k;
+
+                switch (f->deg) {
+                        /* handle low degree polynomials with ad hoc techniques */
+                case 1:
+                        cnt = find_poly_deg1_roots(bch, f, roots+n);
+                        break;
+                case 2:
+                        cnt = find_poly_deg2_roots(bch, f, roots+n);
+                        break;
+                case 3:
+                        cnt = find_poly_deg3_roots(bch, f, roots+n);
+                        break;
+                case 4:
+                        cnt = find_poly_deg4_roots(bch, f, roots+n);
+                        break;
+                default:
+                        /* factor polynomial using Berlekamp Trace Algorithm */
+                        f2 = NULL;
+                        if (f->deg)
+                                factor_polynomial(bch, &k, d, &traces, f,
+                                                  &f1, &f2);
+                        if (!f2)
+                                return -1;
+                        /* solve f1 first, then f2 */
+                        stack[sp].f = f2;
+                        stack[sp++].k = k+1;
+                        stack[sp].f = f1;
+                        stack[sp++].k = k+1;
+                        continue;
+                }
+                if (cnt != (int)f->deg)
+                        return -1;
+                for (i = 0; i < cnt; i++)
+                        if (roots[n+i] >= nbits)
+                                return -1;
+                n += cnt;
+        }
+        return n;
+}
+
+#if defined(USE_CHIEN_SEARCH)
+/*
+ * exhaustive root search (Chien) implementation - not used, included only for
+ * reference/comparison tests
+ */
+static int chien_search(struct bch_control *bch, unsigned int len,
+                        struct gf_poly *p, unsigned int *roots)
+{
+        int m;
+        unsigned int i, j, syn, syn0, count = 0;
+        const unsigned int k = 8*len+bch->ecc_bits;
+
+        /* use a log-based representation of polynomial */
+        gf_poly_logrep(bch, p, bch->cache);
+        bch->cache[p->deg] = 0;
+        syn0 = gf_div(bch, p->c[0], p->c[p->deg]);
+
+        for (i = GF_N(bch)-k+1; i <= GF_N(bch); i++) {
+                /* compute elp(a^i) */
+                for (j = 1, syn = syn0; j <= p->deg; j++) {
+                        m = bch->cache[j];
+                        if (m >= 0)
+                                syn ^= a_pow(bch, m+j*i);
+                }
+                if (syn == 0) {
+                        roots[count++] = GF_N(bch)-i;
+                        if (count == p->deg)
+                                break;
+                }
+        }
+        return (count == p->deg) ? count : 0;
+}
+#define find_poly_roots(_p, _k, _elp, _loc, _nbits) \
+        chien_search(_p, len, _elp, _loc)
+#endif /* USE_CHIEN_SEARCH */
+
+#ifdef BCH_HAVE_CLMUL
+/*
+ * vector Chien search (BCH_DEC_CHIEN): raw error location r is a root of the
+ * error locator polynomial e(X) if e(a^-r) = 0. Lanes hold L = 16 (SSSE3) or
+ * 32 (AVX2) consecutive locations r+k, term j holding e_j.a^(-j(r+k)) split
+ * into low and high byte planes as in the syndrome kernels; each step adds
+ * the terms and multiplies them by a^(-jL) with pshufb tables, so that no
+ * exponentiation is needed per location.
+ *
+ * bch->chien_vec holds, for j=1..t, the 8 tables of multiplication by a^(-jL)
+ * (each 16-byte table repeated L/16 times).
+ */
+
+/*
+ * load lanes @lo/@hi of term e_j.a^(-j(r+k)), k=0..@lanes-1
+ */
+static void chien_init_term(struct bch_control *bch, unsigned int c,
+                            unsigned int j, unsigned int r, unsigned int lanes,
+                            uint8_t *lo, uint8_t *hi)
+{
+        const unsigned int n = GF_N(bch);
+        unsigned int k, l = a_log(bch, c), v;
+
+        for (k = 0; k < lanes; k++) {
+                v = a_pow(bch, l+n-modulo(bch, j*(r+k)));
+                lo[k] = v & 0xff;
+                hi[k] = v >> 8;
+        }
+}
+
+/*
+ * store raw locations r+k of zero lanes of @mask (bit k set for lane k) into
+ * @roots, as long as there are less than @deg roots
+ */
+static BCH_ALWAYS_INLINE unsigned int chien_add_roots(uint32_t mask,
+                                                      unsigned int r,
+                                                      unsigned int *roots,
+                                                      unsigned int cnt,
+                                                      unsigned int deg)
+{
+        while (mask && (cnt < deg)) {
+                roots[cnt++] = r+__builtin_ctz(mask);
+                mask &= mask-1;
+        }
+        return cnt;
+}
+
+/*
+ * find roots of @p among raw locations @start..@end-1, stopping after deg(p)
+ * roots; returns the number of roots found
+ */
+__attribute__((target("ssse3")))
+static unsigned int chien_search_ssse3(struct bch_control *bch,
+                                       const struct gf_poly *p,
+                                       unsigned int start, unsigned int end,
+                                       unsigned int *roots)
+{
+        const unsigned int d = p->deg;
+        const __m128i c0l = _mm_set1_epi8(p->c[0] & 0xff);
+        const __m128i c0h = _mm_set1_epi8(p->c[0] >> 8);
+        const __m128i *tab[d];
+        __m128i lo[d], hi[d], sl, sh;
+        uint8_t bl[16], bh[16];
+        unsigned int j, k, nt = 0, cnt = 0;
+        uint32_t mask;
+
+        for (j = 1; j <= d; j++) {
+                if (!p->c[j])
+                        continue;
+                chien_init_term(bch, p->c[j], j, start, 16, bl, bh);
+                lo[nt] = _mm_loadu_si128((const __m128i *)bl);
+                hi[nt] = _mm_loadu_si128((const __m128i *)bh);
+                tab[nt++] = (const __m128i *)(bch->chien_vec+128*(j-1));
+        }
+
+        for (; (start < end) && (cnt < d); start += 16) {
+                sl = _mm_setzero_si128();
+                sh = _mm_setzero_si128();
+                for (k = 0; k < nt; k++) {
+                        sl = _mm_xor_si128(sl, lo[k]);
+                        sh = _mm_xor_si128(sh, hi[k]);
+                        gf_vec_mul(&lo[k], &hi[k], tab[k]);
+                }
+                mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(sl, c0l),
+                                                       _mm_cmpeq_epi8(sh, c0h)));
+                if (end-start < 16)
+                        mask &= (1u << (end-start))-1;
+                cnt = chien_add_roots(mask, start, roots, cnt, d);
+        }
+        return cnt;
+}
+
+__attribute__((target("avx2")))
+static unsigned int chien_search_avx2(struct bch_control *bch,
+                                      const struct gf_poly *p,
+                                      unsigned int start, unsigned int end,
+                                      unsigned int *roots)
+{
+        const unsigned int d = p->deg;
+        const __m256i c0l = _mm256_set1_epi8(p->c[0] & 0xff);
+        const __m256i c0h = _mm256_set1_epi8(p->c[0] >> 8);
+        const __m256i *tab[d];
+        __m256i lo[d], hi[d], sl, sh;
+        uint8_t bl[32], bh[32];
+        unsigned int j, k, nt = 0, cnt = 0;
+        uint32_t mask;
+
+        for (j = 1; j <= d; j++) {
+                if (!p->c[j])
+                        continue;
+                chien_init_term(bch, p->c[j], j, start, 32, bl, bh);
+                lo[nt] = _mm256_loadu_si256((const __m256i *)bl);
+                hi[nt] = _mm256_loadu_si256((const __m256i *)bh);
+                tab[nt++] = (const __m256i *)(bch->chien_vec+256*(j-1));
+        }
+
+        for (; (start < end) && (cnt < d); start += 32) {
+                sl = _mm256_setzero_si256();
+                sh = _mm256_setzero_si256();
+                for (k = 0; k < nt; k++) {
+                        sl = _mm256_xor_si256(sl, lo[k]);
+                        sh = _mm256_xor_si256(sh, hi[k]);
+                        gf_vec_mul256(&lo[k], &hi[k], tab[k]);
+                }
+                mask = _mm256_movemask_epi8(
+                        _mm256_and_si256(_mm256_cmpeq_epi8(sl, c0l),
+                                         _mm256_cmpeq_epi8(sh, c0h)));
+                if (end-start < 32)
+                        mask &= (1u << (end-start))-1;
+                cnt = chien_add_roots(mask, start, roots, cnt, d);
+        }
+        return cnt;
+}
+
+static unsigned int chien_search_vec(struct bch_control *bch,
+                                     const struct gf_poly *p,
+                                     unsigned int start, unsigned int end,
+                                     unsigned int *roots)
+{
+        if (bch->chien_lanes == 32)
+                return chien_search_avx2(bch, p, start, end, roots);
+        return chien_search_ssse3(bch, p, start, end, roots);
+}
+
+/*
+ * parallel Chien search: the codeword is split into one range of locations per
+ * thread of bch->pool, each range writing its count and roots into its own
+ * slot of bch->par_roots (t+1 entries)
+ */
+struct chien_par_args {
+        struct bch_control   *bch;
+        const struct gf_poly *p;
+        unsigned int          nbits;
+        unsigned int          step;
+};
+
+static void chien_par_task(void *arg, unsigned int i)
+{
+        const struct chien_par_args *args = (const struct chien_par_args *)arg;
+        unsigned int *slot = args->bch->par_roots+i*(GF_T(args->bch)+1);
+        unsigned int start = i*args->step, end = start+args->step;
+
+        if (end > args->nbits)
+                end = args->nbits;
+        slot[0] = (start < end) ?
+                chien_search_vec(args->bch, args->p, start, end, slot+1) : 0;
+}
+
+static unsigned int chien_search_par(struct bch_control *bch,
+                                     const struct gf_poly *p,
+                                     unsigned int nbits, unsigned int *roots)
+{
+        const unsigned int nt = bch->pool.nthreads;
+        const unsigned int lanes = bch->chien_lanes;
+        struct chien_par_args args;
+        unsigned int i, j, cnt = 0, *slot;
+
+        args.bch = bch;
+        args.p = p;
+        args.nbits = nbits;
+        args.step = DIV_ROUND_UP(DIV_ROUND_UP(nbits, nt), lanes)*lanes;
+        bch->pool.parallel_for(bch->pool.ctx, nt, chien_par_task, &args);
+
+        /* merge per-range roots; a degree d polynomial has at most d roots */
+        for (i = 0; i < nt; i++) {
+                slot = bch->par_roots+i*(GF_T(bch)+1);
+                for (j = 0; (j < slot[0]) && (cnt < p->deg); j++)
+                        roots[cnt++] = slot[1+j];
+        }
+        return cnt;
+}
+#endif /* BCH_HAVE_CLMUL */
+
+/*
+ * second half of decode_bch(): unless @syn is provided, the calculated ecc has
+ * been loaded into bch->ecc_buf
+ */
+static int decode_bch_ecc_buf(struct bch_control *bch, unsigned int len,
+                              const uint8_t *recv_ecc, const unsigned int *syn,
+                              unsigned int *errloc)
+{
+    const unsigned int ecc_words = BCH_ECC_WORDS(bch);
+    unsigned int nbits;
+    int i, err, nroots;
+    uint32_t sum;
+
+    if (!syn) {
+        /* load received ecc or assume it was XORed in calc_ecc */
+        if (recv_ecc) {
+            load_ecc8(bch, bch->ecc_buf2, recv_ecc);
+            /* XOR received and calculated ecc */
+            for (i = 0, sum = 0; i < (int)ecc_words; i++) {
+                bch->ecc_buf[i] ^= bch->ecc_buf2[i];
+                sum |= bch->ecc_buf[i];
+            }
+            if (!sum)
+                /* no error found */
+                return 0;
+        }
+        compute_syndromes(bch, bch->ecc_buf, bch->syn);
+        syn = bch->syn;
+    }
 
-        if (tk->deg > 0) {
-                /* compute g = gcd(f, tk) (destructive operation) */
-                gf_poly_copy(f2, f);
-                gcd = gf_poly_gcd(bch, f2, tk);
-                if (gcd->deg < f->deg) {
-                        /* compute h=f/gcd(f,tk); this will modify f and q */
-                        gf_poly_div(bch, f, gcd, q);
-                        /* store g and h in-place (clobbering f) */
-                        *h = &((struct gf_poly_deg1 *)f)[gcd->deg].poly;
-                        gf_poly_copy(*g, gcd);
-                        gf_poly_copy(*h, q);
-                }
+    if ((GF_T(bch) == 1) && !(bch->flags & BCH_DEC_IBM)) {
+        /* a single error, located at log(1/r) = log(S1) */
+        err = syn[0] ? 1 : 0;
+        if (err)
+            errloc[0] = a_log(bch, syn[0]);
+    } else {
+        if (bch->flags & BCH_DEC_IBM)
+            err = compute_error_locator_polynomial_ibm(bch, syn);
+        else if (GF_T(bch) <= 4)
+            err = compute_error_locator_polynomial_small(bch, syn);
+        else
+            err = compute_error_locator_polynomial(bch, syn);
+        if (err > 0) {
+            /* only search roots within the shortened codeword */
+            nbits = (len*8)+bch->ecc_bits;
+#ifdef BCH_HAVE_CLMUL
+            if (bch->chien_bits && (nbits <= bch->chien_bits[err]))
+                nroots = chien_search_vec(bch, bch->elp, 0, nbits, errloc);
+            else if (bch->pool.nthreads && (nbits <= bch->par_bits[err]))
+                nroots = chien_search_par(bch, bch->elp, nbits, errloc);
+            else
+#endif
+            nroots = find_poly_roots(bch, 1, bch->elp, errloc, nbits);
+            if (err != nroots)
+                err = -1;
+        }
+    }
+    if (err > 0) {
+        /* post-process raw error locations for easier correction */
+        nbits = (len*8)+bch->ecc_bits;
+        for (i = 0; i < err; i++) {
+            if (errloc[i] >= nbits) {
+                err = -1;
+                break;
+            }
+            errloc[i] = nbits-1-errloc[i];
+            errloc[i] = (errloc[i] & ~7)|(7-(errloc[i] & 7));
         }
+    }
+    return (err >= 0) ? err : -EBADMSG;
 }
 
 /*
- * find roots of a polynomial, using BTZ algorithm; see the beginning of this
- * file for details
+ * whether decoding should evaluate syndromes directly on data: with byte-wise
+ * syndrome tables this costs about t table lookups per byte, cheaper than
+ * computing the ecc of data with a low-memory encoder (BCH_ENC_LFSR, or
+ * BCH_ENC_NIBBLE for small t, or for any t with the vector kernels), but much
+ * slower than the 4-table or carry-less multiply encoders
  */
-static int find_poly_roots(struct bch_control *bch, unsigned int k,
-                           struct gf_poly *poly, unsigned int *roots)
+static inline int syn_direct(struct bch_control *bch)
 {
-        int cnt;
-        struct gf_poly *f1, *f2;
-
-        switch (poly->deg) {
-                /* handle low degree polynomials with ad hoc techniques */
-        case 1:
-                cnt = find_poly_deg1_roots(bch, poly, roots);
-                break;
-        case 2:
-                cnt = find_poly_deg2_roots(bch, poly, roots);
-                break;
-        case 3:
-                cnt = find_poly_deg3_roots(bch, poly, roots);
-                break;
-        case 4:
-                cnt = find_poly_deg4_roots(bch, poly, roots);
-                break;
-        default:
-                /* factor polynomial using Berlekamp Trace Algorithm (BTA) */
-                cnt = 0;
-                if (poly->deg && (k <= GF_M(bch))) {
-                        factor_polynomial(bch, k, poly, &f1, &f2);
-                        if (f1)
-                                cnt += find_poly_roots(bch, k+1, f1, roots);
-                        if (f2)
-                                cnt += find_poly_roots(bch, k+1, f2, roots+cnt);
-                }
-                break;
-        }
-        return cnt;
+        return bch->syn_tab && !bch->mod8_tab &&
+                (!bch->mod4_tab || bch->syn_vec ||
+                 (GF_T(bch) <= BCH_SYN_DIRECT_MAX_T));
 }
 
-#if defined(USE_CHIEN_SEARCH)
 /*
- * exhaustive root search (Chien) implementation - not used, included only for
- * reference/comparison tests
+ * finish direct syndrome evaluation (odd syndromes of data already in
+ * bch->syn) with received ecc @recv_ecc, and decode
  */
-static int chien_search(struct bch_control *bch, unsigned int len,
-                        struct gf_poly *p, unsigned int *roots)
+static int decode_bch_syn(struct bch_control *bch, unsigned int len,
+                          const uint8_t *recv_ecc, unsigned int *errloc)
 {
-        int m;
-        unsigned int i, j, syn, syn0, count = 0;
-        const unsigned int k = 8*len+bch->ecc_bits;
-
-        /* use a log-based representation of polynomial */
-        gf_poly_logrep(bch, p, bch->cache);
-        bch->cache[p->deg] = 0;
-        syn0 = gf_div(bch, p->c[0], p->c[p->deg]);
-
-        for (i = GF_N(bch)-k+1; i <= GF_N(bch); i++) {
-                /* compute elp(a^i) */
-                for (j = 1, syn = syn0; j <= p->deg; j++) {
-                        m = bch->cache[j];
-                        if (m >= 0)
-                                syn ^= a_pow(bch, m+j*i);
-                }
-                if (syn == 0) {
-                        roots[count++] = GF_N(bch)-i;
-                        if (count == p->deg)
-                                break;
-                }
-        }
-        return (count == p->deg) ? count : 0;
+        syndromes_add_ecc8(bch, recv_ecc, bch->syn);
+        if (!syndromes_finish(bch, bch->syn))
+                /* no error found */
+                return 0;
+        return decode_bch_ecc_buf(bch, len, NULL, bch->syn, errloc);
 }
-#define find_poly_roots(_p, _k, _elp, _loc) chien_search(_p, len, _elp, _loc)
-#endif /* USE_CHIEN_SEARCH */
 
 /**
  * decode_bch - decode received codeword and find bit error locations
@@ -1017,10 +3314,8 @@ int decode_bch(struct bch_control *bch, const uint8_t *data, unsigned int len,
                const uint8_t *recv_ecc, const uint8_t *calc_ecc,
                const unsigned int *syn, unsigned int *errloc)
 {
-    const unsigned int ecc_words = BCH_ECC_WORDS(bch);
-    unsigned int nbits;
-    int i, err, nroots;
-    uint32_t sum;
+    BCH_FIXED_RETURN(bch, decode_bch,
+                     (bch, data, len, recv_ecc, calc_ecc, syn, errloc));
 
     /* sanity check: make sure data length can be handled */
     if ( len > ((bch->n-bch->ecc_bits+7)/8))
@@ -1032,46 +3327,79 @@ int decode_bch(struct bch_control *bch, const uint8_t *data, unsigned int len,
             /* compute received data ecc into an internal buffer */
             if (!data || !recv_ecc)
                 return -EINVAL;
+            if (syn_direct(bch)) {
+                /* evaluate syndromes on the received codeword instead */
+                bch_memset(bch->syn, 0, 2*GF_T(bch)*sizeof(*bch->syn));
+                syndromes_add_bytes(bch, data, len, bch->ecc_bits, bch->syn);
+                return decode_bch_syn(bch, len, recv_ecc, errloc);
+            }
             encode_bch(bch, data, len, NULL);
         } else {
             /* load provided calculated ecc */
             load_ecc8(bch, bch->ecc_buf, calc_ecc);
         }
-        /* load received ecc or assume it was XORed in calc_ecc */
-        if (recv_ecc) {
-            load_ecc8(bch, bch->ecc_buf2, recv_ecc);
-            /* XOR received and calculated ecc */
-            for (i = 0, sum = 0; i < (int)ecc_words; i++) {
-                bch->ecc_buf[i] ^= bch->ecc_buf2[i];
-                sum |= bch->ecc_buf[i];
-            }
-            if (!sum)
-                /* no error found */
-                return 0;
-        }
-        compute_syndromes(bch, bch->ecc_buf, bch->syn);
-        syn = bch->syn;
     }
+    return decode_bch_ecc_buf(bch, len, recv_ecc, syn, errloc);
+}
 
-    err = compute_error_locator_polynomial(bch, syn);
-    if (err > 0) {
-        nroots = find_poly_roots(bch, 1, bch->elp, errloc);
-        if (err != nroots)
-            err = -1;
+/**
+ * decodev_bch - decode received scattered codeword and find bit error locations
+ * @bch:      BCH control structure
+ * @iov:      array of @iovcnt received data fragments
+ * @iovcnt:   number of data fragments
+ * @recv_ecc: received ecc
+ * @errloc:   output array of error locations
+ *
+ * Returns:
+ *  The number of errors found, or -EBADMSG if decoding failed, or -EINVAL if
+ *  invalid parameters were provided
+ *
+ * Same as decode_bch(@bch, data, len, @recv_ecc, NULL, NULL, @errloc) where
+ * data is the concatenation of the @iov fragments and len its total length;
+ * data ecc is computed with encodev_bch(), without copying fragments.
+ * Error locations are bit offsets into that concatenation, with the same
+ * layout as for decode_bch().
+ */
+int decodev_bch(struct bch_control *bch, const struct bch_iovec *iov,
+                unsigned int iovcnt, const uint8_t *recv_ecc,
+                unsigned int *errloc)
+{
+    const size_t max = (bch->n-bch->ecc_bits+7)/8;
+    unsigned int i;
+    size_t len = 0;
+
+    BCH_FIXED_RETURN(bch, decodev_bch, (bch, iov, iovcnt, recv_ecc, errloc));
+
+    if (!recv_ecc)
+        return -EINVAL;
+
+    /*
+     * sanity check: make sure data length can be handled, fragment by
+     * fragment so that the sum cannot wrap around; all lengths then fit in
+     * 32 bits
+     */
+    for (i = 0; i < iovcnt; i++) {
+        if (iov[i].iov_len > max-len)
+            return -EINVAL;
+        len += iov[i].iov_len;
     }
-    if (err > 0) {
-        /* post-process raw error locations for easier correction */
-        nbits = (len*8)+bch->ecc_bits;
-        for (i = 0; i < err; i++) {
-            if (errloc[i] >= nbits) {
-                err = -1;
-                break;
-            }
-            errloc[i] = nbits-1-errloc[i];
-            errloc[i] = (errloc[i] & ~7)|(7-(errloc[i] & 7));
+
+    if (syn_direct(bch)) {
+        /* evaluate syndromes on the received codeword, see decode_bch() */
+        unsigned int d = bch->ecc_bits+8*len;
+
+        bch_memset(bch->syn, 0, 2*GF_T(bch)*sizeof(*bch->syn));
+        for (i = 0; i < iovcnt; i++) {
+            d -= 8*iov[i].iov_len;
+            syndromes_add_bytes(bch, iov[i].iov_base, iov[i].iov_len, d,
+                                bch->syn);
         }
+        return decode_bch_syn(bch, len, recv_ecc, errloc);
     }
-    return (err >= 0) ? err : -EBADMSG;
+
+    /* compute received data ecc into an internal buffer */
+    encodev_bch(bch, iov, iovcnt, NULL);
+    return decode_bch_ecc_buf(bch, len, recv_ecc, NULL, errloc);
 }
 
 /*
@@ -1110,10 +3438,20 @@ static void build_mod8_tables(struct bch_control *bch, const uint32_t *g)
         int i, j, b, d;
         uint32_t data, hi, lo, *tab;
         const int l = BCH_ECC_WORDS(bch);
-        const int plen = DIV_ROUND_UP(bch->ecc_bits+1, 32);
+        /*
+         * g has DIV_ROUND_UP(m*t+1, 32) words and ecc_bits <= m*t; spelling
+         * out the m*t bound lets the compiler prove that g[] accesses stay in
+         * range when m and t are constants (see BCH_CONST_M)
+         */
+        const int gwords = DIV_ROUND_UP(GF_M(bch)*GF_T(bch)+1, 32);
+        const int plen = (bch->ecc_bits < GF_M(bch)*GF_T(bch)) ?
+                DIV_ROUND_UP(bch->ecc_bits+1, 32) : gwords;
         const int ecclen = DIV_ROUND_UP(bch->ecc_bits, 32);
 
-        bch_memset(bch->mod8_tab, 0, 4*256*l*sizeof(*bch->mod8_tab));
+        const int ntabs = 4*bch->enc_words;
+        const uint32_t *src, *red;
+
+        bch_memset(bch->mod8_tab, 0, ntabs*256*l*sizeof(*bch->mod8_tab));
 
         for (i = 0; i < 256; i++) {
                 /* p(X)=i is a small polynomial of weight <= 8 */
@@ -1134,6 +3472,351 @@ static void build_mod8_tables(struct bch_control *bch, const uint32_t *g)
                         }
                 }
         }
+        /*
+         * extra slicing tables: (p(X).X^(8*b+deg(g))) mod g is obtained by
+         * multiplying table b-1 entries by X^8, i.e. shifting them by one byte
+         * and reducing the overflowing byte with table 0
+         */
+        for (b = 4; b < ntabs; b++) {
+                for (i = 0; i < 256; i++) {
+                        src = bch->mod8_tab + ((b-1)*256+i)*l;
+                        tab = bch->mod8_tab + (b*256+i)*l;
+                        red = bch->mod8_tab + (src[0] >> 24)*l;
+                        for (j = 0; j < l-1; j++)
+                                tab[j] = ((src[j] << 8)|(src[j+1] >> 24))^red[j];
+                        tab[l-1] = (src[l-1] << 8)^red[l-1];
+                }
+        }
+#ifdef BCH_NATIVE_LE
+        /* store tables as native words */
+        for (i = 0; i < ntabs*256*l; i++)
+                bch->mod8_tab[i] = NATIVE32(bch->mod8_tab[i]);
+#endif
+}
+
+/*
+ * compute the 16-entry remainder table of the BCH_ENC_NIBBLE encoder: entry i
+ * is (i(X).X^deg(g)) mod g(X), i.e. LFSR state i.X^(deg(g)-4) shifted 4 times
+ */
+static void build_mod4_table(struct bch_control *bch)
+{
+        const unsigned int l = BCH_ECC_WORDS(bch)-1;
+        uint32_t *tab;
+        unsigned int i;
+
+        for (i = 0; i < 16; i++) {
+                tab = bch->mod4_tab+i*(l+1);
+                bch_memset(tab, 0, (l+1)*sizeof(*tab));
+                tab[0] = i << 28;
+                encode_bch_lfsr(bch, tab, 4);
+        }
+}
+
+/*
+ * compute slicing-by-4 tables of the reflected CRC with polynomial @poly: table
+ * k holds the CRC of byte i followed by k zero bytes
+ */
+static void build_crc_tables(struct bch_control *bch, uint32_t poly)
+{
+        uint32_t *tab = bch->crc_tab, c;
+        unsigned int i, j;
+
+        for (i = 0; i < 256; i++) {
+                c = i;
+                for (j = 0; j < 8; j++)
+                        c = (c >> 1)^((c & 1) ? poly : 0);
+                tab[i] = c;
+        }
+        for (i = 256; i < 1024; i++)
+                tab[i] = (tab[i-256] >> 8)^tab[tab[i-256] & 0xff];
+}
+
+/*
+ * compute the minimal polynomial M(X) of a^(2i+1) for each odd syndrome, as the
+ * product of (X+a^r) over the cyclotomic coset r = (2i+1).2^k, and tables for
+ * syndromes_minpoly(): entry b of the reduction table is (b(X).X^deg(M)) mod
+ * M(X), and entry v of evaluation table k is (v(X).X^(4k))(a^(2i+1))
+ */
+static void build_minpoly_tables(struct bch_control *bch)
+{
+        const unsigned int t = GF_T(bch);
+        unsigned int c[BCH_MAX_M+1], i, j, k, b, u, v, r, d, mp;
+        bch_gf_t *tab;
+
+        for (i = 0; i < t; i++) {
+                j = 2*i+1;
+                tab = bch->minpoly_tab+BCH_MINPOLY_TAB_SZ*i;
+                /* multiply c(X) by (X+a^r) for all conjugates a^r of a^j */
+                c[0] = 1;
+                d = 0;
+                r = mod_s(bch, j);
+                do {
+                        c[d+1] = 1;
+                        for (k = d; k > 0; k--)
+                                c[k] = gf_mul(bch, c[k], a_pow(bch, r))^c[k-1];
+                        c[0] = gf_mul(bch, c[0], a_pow(bch, r));
+                        d++;
+                        r = mod_s(bch, 2*r);
+                } while (r != mod_s(bch, j));
+
+                /* coefficients of M(X) are binary */
+                for (k = 0, mp = 0; k <= d; k++)
+                        mp |= (c[k] ? 1u : 0) << k;
+
+                tab[0] = d;
+                for (b = 0; b < 256; b++) {
+                        v = b << d;
+                        for (k = d+7; k >= d; k--)
+                                if (v & (1u << k))
+                                        v ^= mp << (k-d);
+                        tab[1+b] = v;
+                }
+                for (k = 0; k < BCH_GF_NIBBLES; k++) {
+                        for (b = 0; b < 16; b++) {
+                                for (u = 0, v = 0; u < 4; u++)
+                                        if ((b & (1u << u)) && (4*k+u < d))
+                                                v ^= a_pow(bch, j*(4*k+u));
+                                tab[257+16*k+b] = v;
+                        }
+                }
+        }
+}
+
+#ifdef BCH_HAVE_CLMUL
+/*
+ * compute the 8 pshufb tables of multiplication by @c used by gf_vec_mul():
+ * element nibble b at bit 4k, times c, in tables 2k (low plane) and 2k+1
+ * (high plane)
+ */
+static void build_vec_mul_table(struct bch_control *bch, uint8_t *tab,
+                                unsigned int c)
+{
+        unsigned int k, b, v;
+
+        for (k = 0; k < 4; k++) {
+                for (b = 0; b < 16; b++) {
+                        v = b << (4*k);
+                        v = (v >> GF_M(bch)) ? 0 : gf_mul(bch, v, c);
+                        tab[32*k+b] = v & 0xff;
+                        tab[32*k+16+b] = v >> 8;
+                }
+        }
+}
+
+/*
+ * compute pshufb nibble tables of the vector syndrome kernels, see
+ * syndromes_add_bytes_ssse3()
+ */
+static void build_syn_vec_tables(struct bch_control *bch)
+{
+        const unsigned int t = GF_T(bch);
+        unsigned int i, j, k, b, u, v, sh;
+        uint8_t *tab;
+
+        for (i = 0; i < t; i++) {
+                j = 2*i+1;
+                tab = bch->syn_vec+16*BCH_SYN_VEC_TABS*i;
+                /* data nibble b of byte half k: sum of a^(j(4k+u)) */
+                for (k = 0; k < 2; k++) {
+                        for (b = 0; b < 16; b++) {
+                                for (u = 0, v = 0; u < 4; u++)
+                                        if (b & (1u << u))
+                                                v ^= a_pow(bch, j*(4*k+u));
+                                tab[32*k+b] = v & 0xff;
+                                tab[32*k+16+b] = v >> 8;
+                        }
+                }
+                for (sh = 0; sh < 6; sh++)
+                        build_vec_mul_table(bch, tab+64+128*sh,
+                                            a_pow(bch, (8u << sh)*j));
+        }
+}
+
+/*
+ * compute the multiplication tables of the vector Chien search, see
+ * chien_search_ssse3()
+ */
+static void build_chien_vec_tables(struct bch_control *bch)
+{
+        const unsigned int t = GF_T(bch);
+        const unsigned int lanes = bch->chien_lanes;
+        unsigned int j, k, h;
+        uint8_t tab[128];
+
+        for (j = 1; j <= t; j++) {
+                build_vec_mul_table(bch, tab, a_pow(bch, GF_N(bch)-
+                                                    modulo(bch, j*lanes)));
+                for (k = 0; k < 8; k++)
+                        for (h = 0; h < lanes; h += 16)
+                                bch_memcpy(bch->chien_vec+8*lanes*(j-1)+
+                                           lanes*k+h, tab+16*k, 16);
+        }
+}
+
+/*
+ * estimated cost in cycles of finding the roots of a degree @d error locator
+ * polynomial with BTZ factoring, fitted on x86-64 measurements: about 150 for
+ * d <= 2 (closed forms) or d = 3, 4 with root tables, 110m for d = 3, 4
+ * (affine polynomial solver), m(5d^2+100) for d >= 5 (recursive trace
+ * splitting)
+ */
+static uint64_t btz_cost(struct bch_control *bch, unsigned int d)
+{
+        if ((d <= 2) || ((d <= 4) && bch->deg3_tab))
+                return 150;
+        if (d <= 4)
+                return 110*GF_M(bch);
+        return GF_M(bch)*(5*d*d+100);
+}
+
+/*
+ * fill bch->chien_bits: for each error count d, the largest codeword size for
+ * which the vector Chien search is estimated faster than BTZ factoring. The
+ * search costs about (50+60d) cycles per step of L locations, and stops on
+ * average after a fraction d/(d+1) of the codeword.
+ */
+static void build_chien_policy(struct bch_control *bch)
+{
+        unsigned int d;
+        uint64_t bits;
+
+        bch->chien_bits[0] = 0;
+        for (d = 1; d <= GF_T(bch); d++) {
+                bits = btz_cost(bch, d)*bch->chien_lanes*(d+1)/
+                        (d*(50+60*d));
+                bch->chien_bits[d] = (bits < GF_N(bch)) ? bits : GF_N(bch);
+        }
+}
+
+/*
+ * fill bch->par_bits: same as build_chien_policy() for the search split across
+ * the P threads of bch->pool, each thread scanning its whole range, plus a
+ * fixed cost BCH_POOL_DISPATCH_CYCLES per search
+ */
+static void build_chien_par_policy(struct bch_control *bch)
+{
+        const uint64_t p = bch->pool.nthreads;
+        unsigned int d;
+        uint64_t btz, bits;
+
+        bch->par_bits[0] = 0;
+        for (d = 1; d <= GF_T(bch); d++) {
+                btz = btz_cost(bch, d);
+                bits = (btz > BCH_POOL_DISPATCH_CYCLES) ?
+                        (btz-BCH_POOL_DISPATCH_CYCLES)*bch->chien_lanes*p/
+                        (50+60*d) : 0;
+                bch->par_bits[d] = (bits < GF_N(bch)) ? bits : GF_N(bch);
+        }
+}
+#endif
+
+/*
+ * compute byte-wise syndrome tables: entry b of table i is log(b(a^(2i+1))),
+ * where bit u of b is the coefficient of X^u, or GF_N if b(a^(2i+1)) = 0
+ */
+static void build_syn_tables(struct bch_control *bch)
+{
+        const unsigned int t = GF_T(bch);
+        unsigned int i, b, u, v;
+
+        for (i = 0; i < t; i++) {
+                for (b = 0; b < 256; b++) {
+                        for (u = 0, v = 0; u < 8; u++)
+                                if (b & (1u << u))
+                                        v ^= a_pow(bch, (2*i+1)*u);
+                        bch->syn_tab[256*i+b] = v ? a_log(bch, v) : GF_N(bch);
+                }
+        }
+#ifdef BCH_HAVE_CLMUL
+        if (bch->syn_vec)
+                build_syn_vec_tables(bch);
+#endif
+}
+
+#ifdef BCH_HAVE_CLMUL
+/*
+ * compute folding constants K0 = X^(D+128) mod g(X).X^s and
+ * K1 = X^(D+192) mod g(X).X^s for encode_bch_clmul()
+ */
+static void build_clmul_tables(struct bch_control *bch)
+{
+        const unsigned int l = BCH_ECC_WORDS(bch)-1;
+        const unsigned int np = BCH_ECC_PAIRS(bch);
+        static const uint8_t one = 1, zero[16] = {0,};
+        uint32_t r[l+1];
+        uint64_t k0[2*np], k1[2*np];
+        unsigned int j;
+
+        /* left-justified X^(128+deg(g)) mod g(X) is exactly K0, same for K1 */
+        bch_memset(r, 0, sizeof(r));
+        encode_bch_unaligned(bch, &one, 1, r);
+        encode_bch_unaligned(bch, zero, 16, r);
+        ecc_native(bch, r);
+        ecc_to_pairs(bch, r, k0);
+        ecc_native(bch, r);
+        encode_bch_unaligned(bch, zero, 8, r);
+        ecc_native(bch, r);
+        ecc_to_pairs(bch, r, k1);
+
+        for (j = 0; j < 2*np; j++) {
+                bch->clmul_k[2*j]   = k0[j];
+                bch->clmul_k[2*j+1] = k1[j];
+        }
+}
+#endif
+
+/*
+ * number of BCH_ECC_UPDATE shift tables, one per bit of the largest distance in
+ * bytes between changed data and the end of a codeword (< n/8)
+ */
+static unsigned int upd_levels(struct bch_control *bch)
+{
+        return FLS(GF_N(bch)/8);
+}
+
+/*
+ * compute the BCH_ECC_UPDATE tables: a 16-entry table of nibble remainders
+ * v(X).X^deg(g) mod g(X) followed by one 16-entry table per level i, holding
+ * v(X).X^(8.2^i-pad) mod g(X) (see ecc_shift_mul())
+ */
+static void build_upd_tables(struct bch_control *bch)
+{
+        const unsigned int l = BCH_ECC_WORDS(bch)-1;
+        const unsigned int pad = 4*DIV_ROUND_UP(bch->ecc_bits, 4)-bch->ecc_bits;
+        const unsigned int d = bch->ecc_bits-1;
+        unsigned int i, j, v;
+        uint32_t *tab, x[l+1];
+
+        for (v = 0; v < 16; v++) {
+                tab = bch->upd_tab+v*(l+1);
+                bch_memset(tab, 0, (l+1)*sizeof(*tab));
+                tab[0] = v << 28;
+                encode_bch_lfsr(bch, tab, 4);
+        }
+
+        /* x = X^(8-pad) mod g(X) */
+        bch_memset(x, 0, sizeof(x));
+        x[d/32] = 1u << (31-(d & 31));
+        encode_bch_lfsr(bch, x, 8-pad);
+
+        for (i = 0; i < upd_levels(bch); i++) {
+                tab = bch->upd_tab+16*(l+1)*(i+1);
+                bch_memset(tab, 0, (l+1)*sizeof(*tab));
+                /* powers of two first, then their sums */
+                for (v = 1; v < 16; v <<= 1) {
+                        bch_memcpy(tab+v*(l+1), x, sizeof(x));
+                        encode_bch_lfsr(bch, x, 1);
+                }
+                for (v = 3; v < 16; v++)
+                        if (v & (v-1))
+                                for (j = 0; j <= l; j++)
+                                        tab[v*(l+1)+j] =
+                                                tab[(v & (v-1))*(l+1)+j]^
+                                                tab[(v & -v)*(l+1)+j];
+                /* next level: X^(8.2^(i+1)-pad) = X^(8.2^i-pad).X^(8.2^i) */
+                bch_memcpy(x, tab+(l+1), sizeof(x));
+                ecc_shift_mul(bch, x, tab);
+        }
 }
 
 /*
@@ -1174,10 +3857,50 @@ static int build_deg2_base(struct bch_control *bch)
                 }
         }
         /* should not happen but check anyway */
-        return remaining ? -1 : 0;
+        if (remaining)
+                return -1;
+
+        /* BCH_DEC_ROOT_TABLES: map each u = x^2+x to one of its roots x */
+        if (bch->deg2_tab) {
+                bch_memset(bch->deg2_tab, 0, (GF_N(bch)+1)*
+                           sizeof(*bch->deg2_tab));
+                for (x = 2; x <= GF_N(bch); x += 2)
+                        bch->deg2_tab[gf_sqr(bch, x)^x] = x;
+        }
+        return 0;
+}
+
+/*
+ * BCH_DEC_ROOT_TABLES: map each w such that Z^3+Z+w has 3 distinct roots to one
+ * of them, and other values to 0
+ */
+static void build_deg3_table(struct bch_control *bch)
+{
+        const unsigned int n = GF_N(bch);
+        const bch_gf_t seen = (bch_gf_t)1 << (8*sizeof(bch_gf_t)-1);
+        bch_gf_t *tab = bch->deg3_tab;
+        unsigned int z, w;
+
+        bch_memset(tab, 0, (n+1)*sizeof(*tab));
+        /*
+         * w != 0 has 0, 1 or 3 roots (their sum is 0); flag values reached
+         * more than once with the entry top bit (m < 8*sizeof(*tab))
+         */
+        for (z = 2; z <= n; z++) {
+                w = gf_mul(bch, gf_sqr(bch, z), z)^z;
+                tab[w] = tab[w] ? (tab[w] | seen) : z;
+        }
+        for (w = 0; w <= n; w++)
+                tab[w] = (tab[w] & seen) ? (tab[w] & ~seen) : 0;
 }
 
-static char alloc_heap[24576];
+/* static heap used on non-Linux targets, may be overridden at build time */
+#ifndef BCH_HEAP_SIZE
+#define BCH_HEAP_SIZE 24576
+#endif
+
+/* 64-bit words, so that allocations can be 8-byte aligned */
+static uint64_t alloc_heap[DIV_ROUND_UP(BCH_HEAP_SIZE, 8)];
 static int alloc_heap_i = 0;
 
 int bch_check_free() {
@@ -1186,6 +3909,7 @@ int bch_check_free() {
 
 #ifdef __linux__
 #include <stdlib.h>
+#include <sys/mman.h>
 #endif
 #include <stdio.h>
 static void *bch_alloc(size_t size)
@@ -1194,14 +3918,39 @@ static void *bch_alloc(size_t size)
         return malloc(size);
 #else
         void *ptr;
+        /* keep the next allocation aligned for 64-bit and pointer members */
+        size = (size+7) & ~(size_t)7;
         if(alloc_heap_i + size >= sizeof alloc_heap) {
 	  //printf("not enough bch heap!!\n");
           return 0;
 	}
 
-        ptr = alloc_heap + alloc_heap_i;
-        alloc_heap_i += size;
+        ptr = (char *)alloc_heap + alloc_heap_i;
+        alloc_heap_i += size;
+        return ptr;
+#endif
+}
+
+/*
+ * GF(2^m) tables of wide fields span megabytes and are accessed randomly: on
+ * Linux, align them on 2 MiB and ask for transparent huge pages, which spares
+ * most of the TLB misses
+ */
+#define BCH_HUGE_PAGE (2u << 20)
+
+static void *bch_alloc_large(size_t size)
+{
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        void *ptr;
+
+        if (size < BCH_HUGE_PAGE)
+                return bch_alloc(size);
+        if (posix_memalign(&ptr, BCH_HUGE_PAGE, size))
+                return NULL;
+        madvise(ptr, size, MADV_HUGEPAGE);
         return ptr;
+#else
+        return bch_alloc(size);
 #endif
 }
 
@@ -1228,6 +3977,9 @@ static uint32_t *compute_generator_polynomial(struct bch_control *bch)
         roots = (unsigned int*)bch_alloc((bch->n+1)*sizeof(*roots));
         genpoly = (uint32_t*)bch_alloc(DIV_ROUND_UP(m*t+1, 32)*sizeof(*genpoly));
 
+        if (!g || !roots || !genpoly)
+                err = 1;
+
         if (err) {
                 bch_unalloc(genpoly);
                 genpoly = NULL;
@@ -1280,10 +4032,11 @@ finish:
 }
 
 /**
- * init_bch - initialize a BCH encoder/decoder
+ * init_bch_ext - initialize a BCH encoder/decoder with extra options
  * @m:          Galois field order, should be in the range 5-15
  * @t:          maximum error correction capability, in bits
  * @prim_poly:  user-provided primitive polynomial (or 0 to use default)
+ * @flags:      BCH_* option flags (0 gives the same control as init_bch())
  *
  * Returns:
  *  a newly allocated BCH control structure if successful, NULL otherwise
@@ -1299,28 +4052,110 @@ finish:
  * Once init_bch() has successfully returned a pointer to a newly allocated
  * BCH control structure, ecc length in bytes is given by member @ecc_bytes of
  * the structure.
+ *
+ * Encoder flags: BCH_ENC_SLICE8 (resp. BCH_ENC_SLICE16) makes encode_bch()
+ * consume 8 (resp. 16) bytes per iteration, using 8 (resp. 16) remainder
+ * tables instead of 4; table memory grows accordingly (words*2048*4 resp.
+ * words*4096*4 bytes). This shortens the dependency chain on the remainder,
+ * which pays off for small ecc sizes (a few words); for large t the encoder is
+ * bound by table reads and the default 4-table mode is faster.
+ *
+ * Unless one of the above flags or BCH_ENC_TABLE is given, encode_bch() uses
+ * a carry-less multiplication (PCLMULQDQ) backend when the CPU supports it,
+ * and falls back to the 4-table encoder otherwise.
+ *
+ * For memory constrained targets, BCH_ENC_NIBBLE replaces the remainder tables
+ * (words*4096 bytes) with a single 16-entry table (words*64 bytes) consumed 4
+ * bits at a time, and BCH_ENC_LFSR removes encoding tables altogether, running
+ * a bitwise LFSR over the generator polynomial; both are several times slower
+ * than the default encoder, and decoding is not affected.
+ *
+ * BCH_CRC32 (IEEE 802.3) or BCH_CRC32C (Castagnoli) builds 4 KiB of CRC tables
+ * for encode_bch_crc(), which computes the ecc and the CRC of data in a single
+ * pass.
+ *
+ * Decoder flags: BCH_DEC_SYN_TABLE builds t byte-wise syndrome tables (t*512
+ * bytes), so that syndromes are evaluated 8 bits at a time instead of once per
+ * set ecc bit; this speeds up decoding of erroneous codewords. With the
+ * BCH_ENC_LFSR (or, for t <= 8, BCH_ENC_NIBBLE) encoder, the same tables are
+ * used to evaluate syndromes directly on received data and ecc, skipping the
+ * slow ecc computation. On x86-64 CPUs supporting SSSE3 (or AVX2), syndromes
+ * are evaluated 16 (or 32) bytes at a time with pshufb tables instead, which
+ * take another t*832 bytes; direct evaluation is then also used with
+ * BCH_ENC_NIBBLE for any t.
+ *
+ * BCH_DEC_SYN_MINPOLY (t*642 bytes of tables) computes syndromes of the ecc
+ * remainder by reducing it modulo the minimal polynomial of each odd power of
+ * a, a byte at a time, then evaluating the small residue with table lookups:
+ * the cost depends on m and t only, not on the number of errors. It is
+ * slightly faster than scalar byte-wise tables, but about 3 times slower than
+ * the vector kernels; when both options are given, the remainder uses vector
+ * kernels if available and minimal polynomials otherwise. It is implied for
+ * m > 16, where vector kernels are unavailable.
+ *
+ * BCH_DEC_IBM computes the error locator polynomial with an inversion-less
+ * Berlekamp-Massey variant running a fixed schedule of t iterations over t+2
+ * coefficients, instead of the default variant whose work and branches depend
+ * on the number of errors. Its latency is nearly constant for a given t, at
+ * the cost of a higher mean when codewords have few errors.
+ *
+ * BCH_ECC_UPDATE builds (m-2)*words*64 bytes of shift tables, so that
+ * bch_update_ecc() patches the ecc of partially rewritten data in
+ * O(changed bytes + log(len)) instead of re-encoding up to the end of data.
+ *
+ * BCH_DEC_CHIEN (x86-64 with SSSE3, t*128 or t*256 bytes of tables) finds
+ * error locations with a vector Chien search instead of BTZ factoring when a
+ * cost model, depending on m, the number of errors and the codeword size,
+ * predicts it to be faster: in practice only for short codewords with many
+ * errors (e.g. m <= 8); it is ignored on other targets.
+ *
+ * BCH_DEC_ROOT_TABLES builds lookup tables for solving low-degree polynomials
+ * found while searching error locations, as long as each table fits in
+ * BCH_ROOT_TAB_BUDGET bytes (a build-time option, 8 KiB by default): a 2^m-entry
+ * table of quadratic roots (2^(m+1) bytes, m <= 12 by default) replaces a
+ * loop over m bits with a single load, and a table of the same size of roots
+ * of depressed cubics Z^3+Z+w lets cubic and quartic polynomials be solved
+ * with a few lookups, instead of building and solving a linear system over
+ * GF(2). Larger fields silently fall back to computing roots.
+ *
+ * When the library is built with BCH_FIXED_PARAMS, parameters listed there are
+ * handled by codecs compiled for these m and t only (see BCH_CONST_M), whose
+ * GF(2^m) arithmetic and encoder loops use constant sizes; other parameters
+ * get the generic codec. On targets without Linux, each specialized codec
+ * allocates from its own static heap, which bch_check_free() does not report.
  */
-struct bch_control *init_bch(int m, int t, unsigned int prim_poly)
+struct bch_control *init_bch_ext(int m, int t, unsigned int prim_poly,
+                                 unsigned int flags)
 {
-        int err = 0;
+        int err = 0, root_tabs;
         unsigned int i, words;
         uint32_t *genpoly;
         struct bch_control *bch = NULL;
 
         const int min_m = 5;
-        const int max_m = 15;
+        const int max_m = BCH_MAX_M;
 
         /* default primitive polynomials */
         static const unsigned int prim_poly_tab[] = {
                 0x25, 0x43, 0x83, 0x11d, 0x211, 0x409, 0x805, 0x1053, 0x201b,
                 0x402b, 0x8003,
+#ifdef BCH_WIDE_FIELD
+                0x1100b, 0x20009, 0x40081, 0x80027, 0x100009,
+#endif
         };
 
+        if (((flags & BCH_ENC_SLICE8) && (flags & BCH_ENC_SLICE16)) ||
+            ((flags & BCH_ENC_NIBBLE) && (flags & BCH_ENC_LFSR)) ||
+            ((flags & (BCH_ENC_NIBBLE|BCH_ENC_LFSR)) &&
+             (flags & (BCH_ENC_SLICE8|BCH_ENC_SLICE16))) ||
+            ((flags & BCH_CRC32) && (flags & BCH_CRC32C)))
+                /* conflicting encoder options */
+                goto fail;
+
         if ((m < min_m) || (m > max_m))
                 /*
-                 * values of m greater than 15 are not currently supported;
-                 * supporting m > 15 would require changing table base type
-                 * (uint16_t) and a small patch in matrix transposition
+                 * values of m greater than 15 require 32-bit table entries,
+                 * see BCH_WIDE_FIELD in bch.h
                  */
                 goto fail;
 
@@ -1329,6 +4164,27 @@ struct bch_control *init_bch(int m, int t, unsigned int prim_poly)
                 /* invalid t value */
                 goto fail;
 
+        /*
+         * exponents such as (2i+1).j, for i < t and j < n, are computed on 32
+         * bits; this only bounds t for m > 17
+         */
+        if (2ull*t*((1u << m)-1) >> 32)
+                goto fail;
+
+#ifdef BCH_CONST_M
+        /* specialized build, only for the parameters it was compiled for */
+        if ((m != BCH_CONST_M) || (t != BCH_CONST_T))
+                goto fail;
+#elif defined(BCH_FIXED_PARAMS)
+        /* hand matching parameters over to a specialized codec */
+        for (i = 0; i < ARRAY_SIZE(bch_fixed_codecs); i++)
+                if ((bch_fixed_codecs[i]->m == (unsigned int)m) &&
+                    (bch_fixed_codecs[i]->t == (unsigned int)t))
+                        return bch_fixed_codecs[i]->init_bch_ext(m, t,
+                                                                 prim_poly,
+                                                                 flags);
+#endif
+
         /* select a primitive polynomial for generating GF(2^m) */
         if (prim_poly == 0)
                 prim_poly = prim_poly_tab[m-min_m];
@@ -1337,24 +4193,100 @@ struct bch_control *init_bch(int m, int t, unsigned int prim_poly)
         if (bch == NULL)
                 goto fail;
         bch_memset(bch,0,sizeof(*bch));
+#ifdef BCH_CONST_M
+        bch->fixed = &BCH_FIXED_SYM(bch_fixed_codec);
+#endif
 
         bch->m = m;
         bch->t = t;
         bch->n = (1 << m)-1;
         words  = DIV_ROUND_UP(m*t, 32);
         bch->ecc_bytes = DIV_ROUND_UP(m*t, 8);
-        bch->a_pow_tab = (uint16_t*)bch_alloc((1+bch->n)*sizeof(*bch->a_pow_tab));
-        bch->a_log_tab = (uint16_t*)bch_alloc((1+bch->n)*sizeof(*bch->a_log_tab));
-        bch->mod8_tab  = (uint32_t*)bch_alloc(words*1024*sizeof(*bch->mod8_tab));
+        /*
+         * without vector syndrome kernels (m > 16), evaluating syndromes with
+         * a_pow_tab lookups misses the cache; minimal polynomials only need
+         * small tables
+         */
+        if (m > 16)
+                flags |= BCH_DEC_SYN_MINPOLY;
+        bch->flags = flags;
+        bch->enc_words = (flags & BCH_ENC_SLICE16) ? 4 :
+                (flags & BCH_ENC_SLICE8) ? 2 : 1;
+        /* root tables of 2^m entries, within budget */
+        root_tabs = (flags & BCH_DEC_ROOT_TABLES) &&
+                ((sizeof(bch_gf_t) << m) <= BCH_ROOT_TAB_BUDGET);
+        bch->a_pow_tab = (bch_gf_t*)bch_alloc_large((1+bch->n)*
+                                                    sizeof(*bch->a_pow_tab));
+        bch->a_log_tab = (bch_gf_t*)bch_alloc_large((1+bch->n)*
+                                                    sizeof(*bch->a_log_tab));
+        if (flags & BCH_ENC_NIBBLE)
+                bch->mod4_tab = (uint32_t*)bch_alloc(words*16*
+                                                     sizeof(*bch->mod4_tab));
+        else if (!(flags & BCH_ENC_LFSR))
+                bch->mod8_tab = (uint32_t*)bch_alloc(words*1024*bch->enc_words*
+                                                     sizeof(*bch->mod8_tab));
+        if (flags & (BCH_CRC32|BCH_CRC32C))
+                bch->crc_tab = (uint32_t*)bch_alloc(1024*sizeof(*bch->crc_tab));
+        if (flags & BCH_DEC_SYN_TABLE)
+                bch->syn_tab = (bch_gf_t*)bch_alloc(256*t*sizeof(*bch->syn_tab));
+        if (flags & BCH_DEC_SYN_MINPOLY)
+                bch->minpoly_tab = (bch_gf_t*)bch_alloc(BCH_MINPOLY_TAB_SZ*t*
+                                                       sizeof(*bch->minpoly_tab));
+        if (flags & BCH_ECC_UPDATE)
+                bch->upd_tab = (uint32_t*)bch_alloc(16*words*(1+upd_levels(bch))*
+                                                    sizeof(*bch->upd_tab));
+#ifdef BCH_HAVE_CLMUL
+        /* vector kernels split elements into two byte planes (m <= 16) */
+        if ((flags & BCH_DEC_SYN_TABLE) && (m <= 16) && cpu_has_ssse3()) {
+                bch->syn_lanes = cpu_has_avx2() ? 32 : 16;
+                bch->syn_vec = (uint8_t*)bch_alloc(16*BCH_SYN_VEC_TABS*t);
+                if (bch->syn_vec == NULL)
+                        err = 1;
+        }
+        if ((flags & BCH_DEC_CHIEN) && (m <= 16) && cpu_has_ssse3()) {
+                bch->chien_lanes = cpu_has_avx2() ? 32 : 16;
+                bch->chien_vec = (uint8_t*)bch_alloc(8*bch->chien_lanes*t);
+                bch->chien_bits = (uint32_t*)bch_alloc((t+1)*
+                                                       sizeof(*bch->chien_bits));
+                if ((bch->chien_vec == NULL) || (bch->chien_bits == NULL))
+                        err = 1;
+        }
+#endif
         bch->ecc_buf   = (uint32_t*)bch_alloc(words*sizeof(*bch->ecc_buf));
         bch->ecc_buf2  = (uint32_t*)bch_alloc(words*sizeof(*bch->ecc_buf2));
         bch->xi_tab    = (unsigned int*)bch_alloc(m*sizeof(*bch->xi_tab));
+        if (root_tabs) {
+                bch->deg2_tab = (bch_gf_t*)bch_alloc_large((1u << m)*
+                                                           sizeof(*bch->deg2_tab));
+                bch->deg3_tab = (bch_gf_t*)bch_alloc_large((1u << m)*
+                                                           sizeof(*bch->deg3_tab));
+        }
         bch->syn       = (unsigned int*)bch_alloc(2*t*sizeof(*bch->syn));
         bch->cache     = (int*)bch_alloc(2*t*sizeof(*bch->cache));
         bch->elp       = (struct gf_poly*)bch_alloc((t+1)*sizeof(struct gf_poly_deg1));
 
-        for (i = 0; i < ARRAY_SIZE(bch->poly_2t); i++)
+        bch->btz_stack = (struct btz_item*)bch_alloc(t*sizeof(*bch->btz_stack));
+        bch->btz_basis = (int*)bch_alloc(m*t*sizeof(*bch->btz_basis));
+        bch->btz_trace = (unsigned int*)bch_alloc(m*t*sizeof(*bch->btz_trace));
+
+        for (i = 0; i < ARRAY_SIZE(bch->poly_2t); i++) {
                 bch->poly_2t[i] = (struct gf_poly*)bch_alloc(GF_POLY_SZ(2*t));
+                if (!bch->poly_2t[i])
+                        err = 1;
+        }
+
+        /* static heap may be exhausted on small targets */
+        if (!bch->a_pow_tab || !bch->a_log_tab || !bch->ecc_buf ||
+            !bch->ecc_buf2 || !bch->xi_tab || !bch->syn || !bch->cache ||
+            !bch->elp || !bch->btz_stack || !bch->btz_basis ||
+            !bch->btz_trace ||
+            (!bch->mod8_tab && !bch->mod4_tab && !(flags & BCH_ENC_LFSR)) ||
+            (!bch->crc_tab && (flags & (BCH_CRC32|BCH_CRC32C))) ||
+            (!bch->syn_tab && (flags & BCH_DEC_SYN_TABLE)) ||
+            (!bch->minpoly_tab && (flags & BCH_DEC_SYN_MINPOLY)) ||
+            (root_tabs && (!bch->deg2_tab || !bch->deg3_tab)) ||
+            (!bch->upd_tab && (flags & BCH_ECC_UPDATE)))
+                err = 1;
 
         if (err)
                 goto fail;
@@ -1368,12 +4300,59 @@ struct bch_control *init_bch(int m, int t, unsigned int prim_poly)
         if (genpoly == NULL)
                 goto fail;
 
-        build_mod8_tables(bch, genpoly);
-        bch_unalloc(genpoly);
+        /* keep generator polynomial for the bit-sliced and LFSR encoders */
+        bch->genpoly = genpoly;
+        if (bch->mod8_tab)
+                build_mod8_tables(bch, genpoly);
+        if (bch->mod4_tab)
+                build_mod4_table(bch);
+        if (bch->crc_tab)
+                build_crc_tables(bch, (flags & BCH_CRC32C) ? 0x82f63b78 :
+                                 0xedb88320);
+        if (bch->syn_tab)
+                build_syn_tables(bch);
+        if (bch->minpoly_tab)
+                build_minpoly_tables(bch);
+        if (bch->upd_tab)
+                build_upd_tables(bch);
+#ifdef BCH_HAVE_CLMUL
+        if (bch->chien_vec) {
+                build_chien_vec_tables(bch);
+                build_chien_policy(bch);
+        }
+#endif
+
+#ifdef BCH_HAVE_CLMUL
+        if (!(flags & (BCH_ENC_TABLE|BCH_ENC_SLICE8|BCH_ENC_SLICE16|
+                       BCH_ENC_NIBBLE|BCH_ENC_LFSR)) &&
+            cpu_has_clmul()) {
+                bch->clmul_k = (uint64_t*)bch_alloc(4*BCH_ECC_PAIRS(bch)*
+                                                    sizeof(*bch->clmul_k));
+                if (bch->clmul_k == NULL)
+                        goto fail;
+                build_clmul_tables(bch);
+        }
+#endif
 
         err = build_deg2_base(bch);
         if (err)
                 goto fail;
+        if (bch->deg3_tab)
+                build_deg3_table(bch);
+
+#ifdef BCH_HAVE_CLMUL
+        /*
+         * BTZ factoring, hence gf_poly_mod(), is only used beyond degree 4;
+         * its row tables are optional and allocated last, so that they cannot
+         * exhaust a static heap: without them, the scalar or gather kernel is
+         * used
+         */
+        if (t > 4) {
+                bch->mod_tab = (uint32_t*)bch_alloc(BCH_MOD_TAB_ROWS*t*
+                                                    sizeof(*bch->mod_tab));
+                bch->mod_avx2 = cpu_has_avx2();
+        }
+#endif
 
         return bch;
 
@@ -1382,6 +4361,19 @@ fail:
         return NULL;
 }
 
+/**
+ * init_bch - initialize a BCH encoder/decoder
+ * @m:          Galois field order, should be in the range 5-15
+ * @t:          maximum error correction capability, in bits
+ * @prim_poly:  user-provided primitive polynomial (or 0 to use default)
+ *
+ * Same as init_bch_ext() with no option flags.
+ */
+struct bch_control *init_bch(int m, int t, unsigned int prim_poly)
+{
+        return init_bch_ext(m, t, prim_poly, 0);
+}
+
 /**
  *  free_bch - free the BCH control structure
  *  @bch:    BCH control structure to release
@@ -1390,16 +4382,41 @@ void free_bch(struct bch_control *bch)
 {
 #ifdef __linux__
     unsigned int i;
+#endif
+    /* each specialized codec owns its tables (and non-Linux static heap) */
+    if (bch)
+        BCH_FIXED_CALL(bch, free_bch, (bch));
+#ifdef __linux__
     if (bch) {
         bch_unalloc(bch->a_pow_tab);
         bch_unalloc(bch->a_log_tab);
         bch_unalloc(bch->mod8_tab);
+        bch_unalloc(bch->mod4_tab);
+        bch_unalloc(bch->crc_tab);
+        bch_unalloc(bch->syn_tab);
+        bch_unalloc(bch->syn_vec);
+        bch_unalloc(bch->minpoly_tab);
+        bch_unalloc(bch->upd_tab);
+        bch_unalloc(bch->chien_vec);
+        bch_unalloc(bch->chien_bits);
+        bch_unalloc(bch->par_bits);
+        bch_unalloc(bch->par_roots);
+        bch_unalloc(bch->clmul_k);
+        bch_unalloc(bch->genpoly);
         bch_unalloc(bch->ecc_buf);
         bch_unalloc(bch->ecc_buf2);
         bch_unalloc(bch->xi_tab);
+        bch_unalloc(bch->sliced_taps);
+        bch_unalloc(bch->sliced_buf);
+        bch_unalloc(bch->deg2_tab);
+        bch_unalloc(bch->deg3_tab);
         bch_unalloc(bch->syn);
         bch_unalloc(bch->cache);
         bch_unalloc(bch->elp);
+        bch_unalloc(bch->btz_stack);
+        bch_unalloc(bch->btz_basis);
+        bch_unalloc(bch->btz_trace);
+        bch_unalloc(bch->mod_tab);
 
         for (i = 0; i < ARRAY_SIZE(bch->poly_2t); i++)
             bch_unalloc(bch->poly_2t[i]);
@@ -1413,6 +4430,287 @@ void free_bch(struct bch_control *bch)
 #endif
 }
 
+/**
+ * bch_set_thread_pool - split long Chien searches across a thread pool
+ * @bch:    BCH control structure, initialized with BCH_DEC_CHIEN
+ * @pool:   caller thread pool, or NULL to stop using a previous one
+ *
+ * Once a pool is set, decoding functions using @bch split the vector Chien
+ * search into @pool->nthreads ranges of locations searched concurrently with
+ * @pool->parallel_for(), whenever this is estimated faster than BTZ factoring
+ * on a single thread, i.e. for large codewords with many errors and enough
+ * threads. This lowers the latency of each decoding, not the total work: it is
+ * meant for the decoding of a few codewords at a time on a many-core machine.
+ * The pool must remain valid until it is replaced or @bch is released.
+ *
+ * Returns:
+ *  0 on success, or -EINVAL if @bch was not initialized with BCH_DEC_CHIEN or
+ *  the vector Chien search is not supported on this target, or if @pool has
+ *  no thread or the required buffers could not be allocated.
+ */
+int bch_set_thread_pool(struct bch_control *bch,
+                        const struct bch_thread_pool *pool)
+{
+#ifdef BCH_HAVE_CLMUL
+        const unsigned int t = GF_T(bch);
+
+        BCH_FIXED_RETURN(bch, bch_set_thread_pool, (bch, pool));
+        bch_memset(&bch->pool, 0, sizeof(bch->pool));
+        if (pool == NULL)
+                return 0;
+
+        if (!bch->chien_vec || !pool->parallel_for || !pool->nthreads)
+                return -EINVAL;
+
+        /*
+         * buffers are kept across pools and only reallocated to grow, since
+         * bch_unalloc() cannot reclaim static heap memory
+         */
+        if (bch->par_bits == NULL)
+                bch->par_bits = (uint32_t*)bch_alloc((t+1)*
+                                                     sizeof(*bch->par_bits));
+        if (bch->par_threads < pool->nthreads) {
+                bch_unalloc(bch->par_roots);
+                bch->par_roots = (unsigned int*)bch_alloc(pool->nthreads*(t+1)*
+                                                          sizeof(*bch->par_roots));
+                bch->par_threads = bch->par_roots ? pool->nthreads : 0;
+        }
+        if (!bch->par_bits || !bch->par_roots)
+                return -EINVAL;
+        bch->pool = *pool;
+        build_chien_par_policy(bch);
+        return 0;
+#else
+        return pool ? -EINVAL : 0;
+#endif
+}
+
+/*
+ * update reflected CRC @crc (pre-inverted) with @len bytes of @data, one byte
+ * at a time
+ */
+static uint32_t crc_bytes(const uint32_t *tab, uint32_t crc,
+                          const uint8_t *data, unsigned int len)
+{
+        while (len--)
+                crc = (crc >> 8)^tab[(crc^(*data++)) & 0xff];
+        return crc;
+}
+
+/*
+ * slicing-by-4 CRC step: @c is the CRC xored with the next 4 data bytes, read
+ * as a little-endian word
+ */
+static inline uint32_t crc_word(const uint32_t *tab, uint32_t c)
+{
+        return tab[768+(c & 0xff)]^tab[512+((c >> 8) & 0xff)]^
+                tab[256+((c >> 16) & 0xff)]^tab[c >> 24];
+}
+
+#ifdef BCH_HAVE_CLMUL
+/*
+ * update reflected CRC @crc (pre-inverted) with @len bytes of @data
+ */
+static uint32_t crc_update(const uint32_t *tab, uint32_t crc,
+                           const uint8_t *data, unsigned int len)
+{
+        unsigned int mlen = (4-(((unsigned long)data) & 3)) & 3;
+
+        if (mlen > len)
+                mlen = len;
+        crc = crc_bytes(tab, crc, data, mlen);
+        data += mlen;
+        len  -= mlen;
+
+        for (; len >= 4; data += 4, len -= 4)
+                crc = crc_word(tab, crc^LOAD_LE32(data));
+
+        return crc_bytes(tab, crc, data, len);
+}
+#endif
+
+/*
+ * same as encode_bch_words() with the 4-table encoder, also updating CRC @crc
+ * (pre-inverted) over the same data: each aligned data word is loaded once
+ * and fed to both the remainder and the slicing-by-4 CRC tables
+ */
+static uint32_t encode_bch_crc_words(struct bch_control *bch,
+                                     const uint8_t *data, unsigned int len,
+                                     uint32_t *ecc, uint32_t crc)
+{
+        const unsigned int l = BCH_ECC_WORDS(bch)-1;
+        const uint32_t * const ct = bch->crc_tab;
+        unsigned int i, mlen;
+        unsigned long m;
+        uint32_t w, c, r[l+1];
+        const uint32_t *tab0, *tab1, *tab2, *tab3;
+        const uint32_t *pdata, *p0, *p1, *p2, *p3;
+
+        if (!bch->mod8_tab) {
+                /* low-memory encoder, interleaved at byte granularity */
+                for (i = 0; i < len; i++) {
+                        crc = crc_bytes(ct, crc, data+i, 1);
+                        encode_bch_compact(bch, data+i, 1, ecc);
+                }
+                return crc;
+        }
+#ifdef BCH_HAVE_CLMUL
+        /*
+         * the carry-less multiply encoder is faster than the fused loop, even
+         * with a second (cache-hot) read of data for the CRC: use it on
+         * blocks small enough to stay in L1 cache
+         */
+        if (bch->clmul_k && (len >= BCH_CLMUL_MIN_LEN)) {
+                while (len) {
+                        mlen = (len < BCH_CRC_BLOCK) ? len : BCH_CRC_BLOCK;
+                        encode_bch_words(bch, data, mlen, ecc);
+                        crc = crc_update(ct, crc, data, mlen);
+                        data += mlen;
+                        len  -= mlen;
+                }
+                return crc;
+        }
+#endif
+        tab0 = bch->mod8_tab;
+        tab1 = tab0 + 256*(l+1);
+        tab2 = tab1 + 256*(l+1);
+        tab3 = tab2 + 256*(l+1);
+
+        for (i = 0; i <= l; i++)
+                r[i] = NATIVE32(ecc[i]);
+
+        /* process first unaligned data bytes */
+        m = ((unsigned long)data) & 3;
+        if (m) {
+                mlen = (len < (4-m)) ? len : 4-m;
+                crc = crc_bytes(ct, crc, data, mlen);
+                encode_bch_unaligned(bch, data, mlen, r);
+                data += mlen;
+                len  -= mlen;
+        }
+
+        /* process 32-bit aligned data words */
+        pdata = (uint32_t *)data;
+        mlen  = len/4;
+        data += 4*mlen;
+        len  -= 4*mlen;
+
+        while (mlen--) {
+                /* crc reads the word in little-endian format */
+                c = crc^LOAD_LE32((const uint8_t *)pdata);
+                /* input data is read in big-endian format */
+                w = r[0]^NATIVE_DATA32(*pdata++);
+                p0 = tab0 + (l+1)*NATIVE_BYTE(w, 0);
+                p1 = tab1 + (l+1)*NATIVE_BYTE(w, 1);
+                p2 = tab2 + (l+1)*NATIVE_BYTE(w, 2);
+                p3 = tab3 + (l+1)*NATIVE_BYTE(w, 3);
+
+                crc = crc_word(ct, c);
+
+                for (i = 0; i < l; i++)
+                        r[i] = r[i+1]^p0[i]^p1[i]^p2[i]^p3[i];
+
+                r[l] = p0[l]^p1[l]^p2[l]^p3[l];
+        }
+
+        /* process last unaligned bytes */
+        if (len) {
+                crc = crc_bytes(ct, crc, data, len);
+                encode_bch_unaligned(bch, data, len, r);
+        }
+
+        for (i = 0; i <= l; i++)
+                ecc[i] = NATIVE32(r[i]);
+        return crc;
+}
+
+/**
+ * encode_bch_crc - calculate BCH ecc parity and CRC of data in a single pass
+ * @bch:   BCH control structure, initialized with BCH_CRC32 or BCH_CRC32C
+ * @data:  data to encode
+ * @len:   data length in bytes
+ * @out:   ecc parity and CRC, used both as input and output
+ *
+ * Returns:
+ *  0 on success, or -EINVAL if @bch was not initialized with a CRC option
+ *
+ * This is the same as encode_bch(@bch, @data, @len, @out->ecc) followed by a
+ * CRC computation over @data, but with the table encoder data is only read
+ * once: each aligned data word updates both the ecc remainder and the CRC.
+ * The CRC is the one selected with init_bch_ext() flags, with the usual ~0
+ * initial value and final inversion; @out->crc should be 0 before the first
+ * call and holds the CRC of all data processed so far after each call (zlib
+ * crc32() convention), so that incremental computations work as with the ecc.
+ * If @out->ecc is %NULL, the ecc is computed into an internal buffer as with
+ * encode_bch().
+ *
+ * The single pass uses the 4-table (or low-memory) encoder, whatever encoder
+ * options were given at initialization; when the carry-less multiply encoder
+ * is in use, which is faster, data is processed in 4 KiB blocks instead, each
+ * block being read a second time from cache for the CRC.
+ */
+int encode_bch_crc(struct bch_control *bch, const uint8_t *data,
+                   unsigned int len, struct bch_encode_out *out)
+{
+        BCH_FIXED_RETURN(bch, encode_bch_crc, (bch, data, len, out));
+
+        if (!bch->crc_tab)
+                return -EINVAL;
+
+        if (out->ecc)
+                load_ecc8(bch, bch->ecc_buf, out->ecc);
+        else
+                bch_memset(bch->ecc_buf, 0,
+                           BCH_ECC_WORDS(bch)*sizeof(*bch->ecc_buf));
+
+        out->crc = ~encode_bch_crc_words(bch, data, len, bch->ecc_buf,
+                                         ~out->crc);
+
+        if (out->ecc)
+                store_ecc8(bch, out->ecc, bch->ecc_buf);
+        return 0;
+}
+
+/**
+ * init_bch_encoder - allocate a persistent encoder context
+ * @bch:   BCH control structure
+ *
+ * Returns:
+ *  a new encoder context, or %NULL if allocation failed
+ *
+ * The context keeps the ecc remainder of a codeword in native 32-bit words
+ * (the representation of the table-driven encoder loops) between calls, so that data can be fed in arbitrary
+ * fragments with encode_bch_update() without converting parity bytes each
+ * time. It holds a reference to @bch, which must outlive it. The
+ * context starts with a zero remainder; encode_bch_init() restarts it.
+ */
+struct bch_encoder *init_bch_encoder(struct bch_control *bch)
+{
+        struct bch_encoder *enc;
+
+        BCH_FIXED_RETURN(bch, init_bch_encoder, (bch));
+        enc = (struct bch_encoder *)bch_alloc(sizeof(*enc)+BCH_ECC_WORDS(bch)*
+                                              sizeof(*enc->ecc_buf));
+        if (enc == NULL)
+                return NULL;
+
+        enc->bch = bch;
+        enc->ecc_buf = (uint32_t *)(enc+1);
+        encode_bch_init(enc, NULL);
+        return enc;
+}
+
+/**
+ * free_bch_encoder - free an encoder context
+ * @enc:   encoder context, as returned by init_bch_encoder()
+ */
+void free_bch_encoder(struct bch_encoder *enc)
+{
+        if (enc)
+                BCH_FIXED_CALL(enc->bch, free_bch_encoder, (enc));
+        bch_unalloc(enc);
+}
+
 static void check_databuf(struct bch_control *bch)
 {
     if (bch->databuf == NULL)
@@ -1481,13 +4779,292 @@ static void pack_eccbits(struct bch_control *bch ,const uint8_t * ecc)
  */
 void encodebits_bch(struct bch_control *bch, const uint8_t *data, uint8_t *ecc)
 {
-    int ndatabytes = pack_databuf(bch,data);
-    uint8_t * ecc_bytes = bch->databuf + ndatabytes;
+    int ndatabytes;
+    uint8_t * ecc_bytes;
+
+    BCH_FIXED_CALL(bch, encodebits_bch, (bch, data, ecc));
+
+    ndatabytes = pack_databuf(bch,data);
+    ecc_bytes = bch->databuf + ndatabytes;
     bch_memset(ecc_bytes,0,bch->ecc_bytes);
     encode_bch(bch,bch->databuf,ndatabytes,ecc_bytes);
     unpack_eccbits(bch,ecc);
 }
 
+/*
+ * bit-sliced LFSR: each of the ecc_bits state bits (and each input bit) is a
+ * group of @lanes 64-bit words holding that bit for 64*@lanes codewords, so
+ * that a single XOR updates the state of all of them
+ *
+ * Rather than shifting the whole state b(X) at each step, only feedback bits
+ * f_s are computed: with b(X) <- X.b(X)+f_s.g(X) and f_s = u_s+b_(r-1), the
+ * top state bit at step s is the sum of f_(s-d) over d = r-i for all nonzero
+ * terms g_i.X^i of g(X). Parity bits are rebuilt from the last feedback bits at
+ * the end, and the initial state is converted into r "past" feedback bits.
+ */
+static BCH_ALWAYS_INLINE void encode_bch_sliced_lanes(struct bch_control *bch,
+        const uint64_t *data, unsigned int nbits, uint64_t *ecc,
+        const unsigned int lanes)
+{
+    const unsigned int r = bch->ecc_bits;
+    unsigned int *taps = bch->sliced_taps, *dist = taps+r, ntaps = 0, i, j, k, n;
+    uint64_t *buf = bch->sliced_buf, acc[4], prev[4] = {0}, *f;
+    int d1;
+
+    /* taps are the nonzero terms g_i.X^i of g(X), 0 <= i < deg(g) */
+    for (i = 0; i < r; i++)
+        if (bch->genpoly[(r-i)/32] & (1u << (31-((r-i) & 31))))
+            taps[ntaps++] = i;
+
+    /* d = 1 (i.e. g_(r-1) = 1) is handled separately, in registers */
+    d1 = (ntaps > 0) && (taps[ntaps-1] == r-1);
+    if (d1)
+        ntaps--;
+
+    /*
+     * f[-r..-1] are past feedback bits: solve b_q = sum(f_(-1-(q-i))) for
+     * taps i <= q, q = 0..r-1 (b_q is the coefficient of X^q of the parity)
+     */
+    f = buf+r*lanes;
+    for (j = 0; j < r; j++) {
+        for (k = 0; k < lanes; k++)
+            acc[k] = ecc[(r-1-j)*lanes+k];
+        for (i = 1; i < ntaps && taps[i] <= j; i++)
+            for (k = 0; k < lanes; k++)
+                acc[k] ^= (f-(j+1-taps[i])*lanes)[k];
+        if (d1 && (r-1 <= j))
+            for (k = 0; k < lanes; k++)
+                acc[k] ^= (f-(j+2-r)*lanes)[k];
+        for (k = 0; k < lanes; k++)
+            (f-(j+1)*lanes)[k] = acc[k];
+        if (j == 0)
+            for (k = 0; k < lanes; k++)
+                prev[k] = acc[k];
+    }
+    for (i = 0; i < ntaps; i++)
+        dist[i] = (r-taps[i])*lanes;
+
+    while (nbits) {
+        n = (nbits < BCH_SLICED_BLOCK) ? nbits : BCH_SLICED_BLOCK;
+        nbits -= n;
+        while (n--) {
+            /*
+             * f_s = u_s + sum(f_(s-r+i)); f_(s-1) is added last so that only
+             * one XOR per step lies on the loop-carried dependency chain
+             */
+            for (k = 0; k < lanes; k++)
+                acc[k] = data[k];
+            for (i = 0; i < ntaps; i++)
+                for (k = 0; k < lanes; k++)
+                    acc[k] ^= (f-dist[i])[k];
+            for (k = 0; k < lanes; k++)
+                prev[k] = f[k] = acc[k]^(d1 ? prev[k] : 0);
+            data += lanes;
+            f += lanes;
+        }
+        /* move the last r feedback bits back to the top of the buffer */
+        for (i = 0; i < r*lanes; i++)
+            buf[i] = (f-r*lanes)[i];
+        f = buf+r*lanes;
+    }
+
+    /* b_q = sum(f_(-1-(q-i))) for taps i <= q */
+    if (d1)
+        taps[ntaps++] = r-1;
+    for (j = 0; j < r; j++) {
+        for (k = 0; k < lanes; k++)
+            acc[k] = 0;
+        for (i = 0; i < ntaps && taps[i] <= j; i++)
+            for (k = 0; k < lanes; k++)
+                acc[k] ^= (f-(j+1-taps[i])*lanes)[k];
+        for (k = 0; k < lanes; k++)
+            ecc[(r-1-j)*lanes+k] = acc[k];
+    }
+}
+
+static void encode_bch_sliced64(struct bch_control *bch, const uint64_t *data,
+                                unsigned int nbits, uint64_t *ecc)
+{
+    encode_bch_sliced_lanes(bch, data, nbits, ecc, 1);
+}
+
+static void encode_bch_sliced256(struct bch_control *bch, const uint64_t *data,
+                                 unsigned int nbits, uint64_t *ecc)
+{
+    encode_bch_sliced_lanes(bch, data, nbits, ecc, 4);
+}
+
+#ifdef BCH_HAVE_CLMUL
+__attribute__((target("avx2")))
+static void encode_bch_sliced256_avx2(struct bch_control *bch,
+                                      const uint64_t *data, unsigned int nbits,
+                                      uint64_t *ecc)
+{
+    encode_bch_sliced_lanes(bch, data, nbits, ecc, 4);
+}
+#endif
+
+/*
+ * allocate bit-sliced encoder taps and feedback bits (up to 4 lanes) on first
+ * use, so that codecs not using this encoder are not charged for them
+ */
+static int check_sliced_buf(struct bch_control *bch)
+{
+    const unsigned int r = bch->ecc_bits;
+
+    if (bch->sliced_buf)
+        return 0;
+    if (r > BCH_SLICED_MAX_BITS)
+        return -EINVAL;
+    if (bch->sliced_taps == NULL)
+        bch->sliced_taps = (unsigned int*)bch_alloc(2*r*sizeof(*bch->sliced_taps));
+    if (bch->sliced_taps == NULL)
+        return -EINVAL;
+    bch->sliced_buf = (uint64_t*)bch_alloc((r+BCH_SLICED_BLOCK)*4*
+                                           sizeof(*bch->sliced_buf));
+    return bch->sliced_buf ? 0 : -EINVAL;
+}
+
+/**
+ * encodebits_bch_sliced - calculate BCH ecc parity bits of many codewords
+ * @bch:   BCH control structure
+ * @data:  bit-sliced data bits, @nbits groups of @lanes words
+ * @nbits: number of data bits per codeword (bch->n - bch->ecc_bits for a
+ *         full-length code, as in encodebits_bch)
+ * @ecc:   bit-sliced ecc parity bits, bch->ecc_bits groups of @lanes words,
+ *         must be initialized by caller
+ * @lanes: 1 (64 codewords) or 4 (256 codewords)
+ *
+ * Returns:
+ *  0 on success, or -EINVAL if @lanes is not supported, m*t exceeds
+ *  BCH_SLICED_MAX_BITS or the encoder buffers could not be allocated
+ *
+ * Group i of @data (words @data[i*@lanes] to @data[i*@lanes+@lanes-1]) holds
+ * data bit i of all codewords, codeword c being bit c%64 of word c/64 of the
+ * group; @ecc is laid out the same way. Bit order is the one of
+ * encodebits_bch(), see bch_slice_bits() and bch_unslice_bits() for
+ * converting from/to one-bit-per-byte codewords.
+ *
+ * As with encode_bch(), @ecc is used both as input and output parameter, in
+ * order to allow incremental computations; it should be zeroed before the
+ * first call. The encoder is a bit-serial LFSR over the generator polynomial,
+ * costing one XOR per nonzero term of g(X) per input bit for all codewords at
+ * once; it is the fastest option for small m (m <= 8) codes when many
+ * codewords are available. On x86-64 CPUs supporting AVX2, 256 codewords are
+ * processed with 256-bit XORs.
+ */
+int encodebits_bch_sliced(struct bch_control *bch, const uint64_t *data,
+                          unsigned int nbits, uint64_t *ecc,
+                          unsigned int lanes)
+{
+    BCH_FIXED_RETURN(bch, encodebits_bch_sliced,
+                     (bch, data, nbits, ecc, lanes));
+
+    if (((lanes != 1) && (lanes != 4)) || check_sliced_buf(bch))
+        return -EINVAL;
+
+    if (lanes == 1) {
+        encode_bch_sliced64(bch, data, nbits, ecc);
+    } else {
+#ifdef BCH_HAVE_CLMUL
+        if (cpu_has_avx2()) {
+            encode_bch_sliced256_avx2(bch, data, nbits, ecc);
+            return 0;
+        }
+#endif
+        encode_bch_sliced256(bch, data, nbits, ecc);
+    }
+    return 0;
+}
+
+/* LSB of each of 8 bytes, packed as little-endian 64-bit word */
+#define BCH_BYTE_LSBS 0x0101010101010101ull
+
+static inline uint64_t load_le64(const uint8_t *p)
+{
+    return (uint64_t)p[0]|((uint64_t)p[1] << 8)|((uint64_t)p[2] << 16)|
+        ((uint64_t)p[3] << 24)|((uint64_t)p[4] << 32)|((uint64_t)p[5] << 40)|
+        ((uint64_t)p[6] << 48)|((uint64_t)p[7] << 56);
+}
+
+static inline void store_le64(uint8_t *p, uint64_t x)
+{
+    unsigned int i;
+
+    for (i = 0; i < 8; i++)
+        p[i] = (uint8_t)(x >> (8*i));
+}
+
+/**
+ * bch_slice_bits - transpose one-bit-per-byte codewords into bit-sliced words
+ * @bits:   array of @count codewords, each an array of @nbits bytes (only the
+ *          LSB of each byte is used, as in encodebits_bch)
+ * @nbits:  number of bits per codeword
+ * @count:  number of codewords, at most 64*@lanes
+ * @sliced: output, @nbits groups of @lanes words (see encodebits_bch_sliced)
+ * @lanes:  number of 64-bit words per group
+ *
+ * Missing codewords (@count < 64*@lanes) are encoded as zero bits.
+ */
+void bch_slice_bits(const uint8_t * const *bits, unsigned int nbits,
+                    unsigned int count, uint64_t *sliced, unsigned int lanes)
+{
+    unsigned int i, j, c;
+    uint64_t x, mask;
+
+    bch_memset(sliced, 0, nbits*lanes*sizeof(*sliced));
+
+    /*
+     * 8x8 blocks: gather bits i..i+7 of codewords c..c+7 so that byte b of x
+     * holds bit i+b of the 8 codewords, then scatter the 8 bytes of x
+     */
+    for (c = 0; c+8 <= count; c += 8) {
+        for (i = 0; i+8 <= nbits; i += 8) {
+            x = 0;
+            for (j = 0; j < 8; j++)
+                x |= (load_le64(bits[c+j]+i) & BCH_BYTE_LSBS) << j;
+            for (j = 0; j < 8; j++)
+                sliced[(i+j)*lanes+c/64] |=
+                    ((x >> (8*j)) & 0xff) << (c & 63);
+        }
+    }
+    /* remaining bits, one at a time */
+    for (c = 0; c < count; c++) {
+        mask = (uint64_t)1 << (c & 63);
+        for (i = (c < (count & ~7u)) ? (nbits & ~7u) : 0; i < nbits; i++)
+            sliced[i*lanes+c/64] |= mask & -(uint64_t)(bits[c][i] & 1);
+    }
+}
+
+/**
+ * bch_unslice_bits - transpose bit-sliced words into one-bit-per-byte codewords
+ * @sliced: @nbits groups of @lanes words (see encodebits_bch_sliced)
+ * @nbits:  number of bits per codeword
+ * @count:  number of codewords, at most 64*@lanes
+ * @bits:   array of @count output codewords, each an array of @nbits bytes
+ * @lanes:  number of 64-bit words per group
+ */
+void bch_unslice_bits(const uint64_t *sliced, unsigned int nbits,
+                      unsigned int count, uint8_t * const *bits,
+                      unsigned int lanes)
+{
+    unsigned int i, j, c;
+
+    /* inverse of the 8x8 block transpose of bch_slice_bits() */
+    for (c = 0; c+8 <= count; c += 8) {
+        for (i = 0; i+8 <= nbits; i += 8) {
+            uint64_t x = 0;
+            for (j = 0; j < 8; j++)
+                x |= ((sliced[(i+j)*lanes+c/64] >> (c & 63)) & 0xff) << (8*j);
+            for (j = 0; j < 8; j++)
+                store_le64(bits[c+j]+i, (x >> j) & BCH_BYTE_LSBS);
+        }
+    }
+    for (c = 0; c < count; c++)
+        for (i = (c < (count & ~7u)) ? (nbits & ~7u) : 0; i < nbits; i++)
+            bits[c][i] = (sliced[i*lanes+c/64] >> (c & 63)) & 1;
+}
+
 /**
  * decodebits_bch - decode received codeword bits and find error locations
  * @bch:      BCH control structure
@@ -1512,6 +5089,8 @@ int decodebits_bch(struct bch_control *bch, const uint8_t *data, const uint8_t *
     int nbytes;
     int nerr;
 
+    BCH_FIXED_RETURN(bch, decodebits_bch, (bch, data, recv_ecc, errloc));
+
     if ( (data==NULL) ||(recv_ecc==NULL)) {
         return -EINVAL; // TODO handle the same calling conventions as decode_bch
     }
@@ -1540,6 +5119,7 @@ int decodebits_bch(struct bch_control *bch, const uint8_t *data, const uint8_t *
 void correct_bch(struct bch_control *bch, uint8_t *data, unsigned int len,unsigned int *errloc, int nerr)
 {
     int i;
+    BCH_FIXED_CALL(bch, correct_bch, (bch, data, len, errloc, nerr));
     for (i=0;i<nerr;++i) {
         int bi = errloc[i];
         if ( (bi>>3) < len)
@@ -1557,9 +5137,39 @@ void correctbits_bch(struct bch_control *bch, uint8_t *databits, unsigned int *e
 {
     const int m = bch->n - bch->ecc_bits;
     int i;
+    BCH_FIXED_CALL(bch, correctbits_bch, (bch, databits, errloc, nerr));
     for (i=0;i<nerr;++i) {
         int bi = errloc[i];
         if (bi < m)
             databits[bi] ^= 1;
     }
 }
+
+#ifdef BCH_CONST_M
+const struct bch_fixed_codec BCH_FIXED_SYM(bch_fixed_codec) = {
+        .m                     = BCH_CONST_M,
+        .t                     = BCH_CONST_T,
+        .init_bch_ext          = init_bch_ext,
+        .free_bch              = free_bch,
+        .bch_set_thread_pool   = bch_set_thread_pool,
+        .encode_bch            = encode_bch,
+        .encode_bch_crc        = encode_bch_crc,
+        .encodev_bch           = encodev_bch,
+        .init_bch_encoder      = init_bch_encoder,
+        .free_bch_encoder      = free_bch_encoder,
+        .encode_bch_init       = encode_bch_init,
+        .encode_bch_update     = encode_bch_update,
+        .encode_bch_final      = encode_bch_final,
+        .encode_bch_batch      = encode_bch_batch,
+        .encodebits_bch        = encodebits_bch,
+        .encodebits_bch_sliced = encodebits_bch_sliced,
+        .bch_verify            = bch_verify,
+        .bch_verify_batch      = bch_verify_batch,
+        .bch_update_ecc        = bch_update_ecc,
+        .decode_bch            = decode_bch,
+        .decodev_bch           = decodev_bch,
+        .decodebits_bch        = decodebits_bch,
+        .correct_bch           = correct_bch,
+        .correctbits_bch       = correctbits_bch,
+};
+#endif
@@ -26,12 +26,39 @@
 #ifndef _BCH_H
 #define _BCH_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/*
+ * GF(2^m) table entry type: 16-bit entries support m up to 15; defining
+ * BCH_WIDE_FIELD, both when building the library and when including this
+ * header, selects 32-bit entries and supports m up to 20
+ */
+#ifdef BCH_WIDE_FIELD
+typedef uint32_t bch_gf_t;
+#else
+typedef uint16_t bch_gf_t;
+#endif
+
+/**
+ * struct bch_thread_pool - caller thread pool for bch_set_thread_pool()
+ * @parallel_for: calls @fn(@arg, i) for i=0..@count-1, concurrently as far as
+ *              possible, and returns once all calls have completed
+ * @ctx:        opaque pool context, passed to @parallel_for
+ * @nthreads:   number of calls that @parallel_for can run concurrently
+ */
+struct bch_thread_pool {
+	void          (*parallel_for)(void *ctx, unsigned int count,
+				      void (*fn)(void *arg, unsigned int i),
+				      void *arg);
+	void           *ctx;
+	unsigned int    nthreads;
+};
+
 /**
  * struct bch_control - BCH control structure
  * @m:          Galois field order
@@ -39,15 +66,44 @@ extern "C" {
  * @t:          error correction capability in bits
  * @ecc_bits:   ecc exact size in bits, i.e. generator polynomial degree (<=m*t)
  * @ecc_bytes:  ecc max size (m*t bits) in bytes
+ * @flags:      init_bch_ext() option flags
+ * @fixed:      compile-time specialized codec owning this structure, or NULL
+ * @enc_words:  32-bit data words consumed per encoder iteration (1, 2 or 4)
  * @a_pow_tab:  Galois field GF(2^m) exponentiation lookup table
  * @a_log_tab:  Galois field GF(2^m) log lookup table
  * @mod8_tab:   remainder generator polynomial lookup tables
+ * @mod4_tab:   16-entry remainder table of the BCH_ENC_NIBBLE encoder
+ * @crc_tab:    slicing-by-4 CRC tables (BCH_CRC32 or BCH_CRC32C)
+ * @syn_tab:    byte-wise syndrome tables (BCH_DEC_SYN_TABLE)
+ * @syn_vec:    vector syndrome kernel tables (NULL if kernels unused)
+ * @syn_lanes:  widest vector syndrome kernel, in bytes (16 or 32)
+ * @minpoly_tab: minimal polynomial syndrome tables (BCH_DEC_SYN_MINPOLY)
+ * @upd_tab:    bch_update_ecc() shift tables (BCH_ECC_UPDATE)
+ * @chien_vec:  vector Chien search tables (NULL if kernels unused)
+ * @chien_lanes: vector Chien search width, in locations (16 or 32)
+ * @chien_bits: largest codeword size in bits, per error count, for which
+ *              Chien search is used instead of BTZ factoring
+ * @pool:       caller thread pool, see bch_set_thread_pool()
+ * @par_bits:   same as @chien_bits for the Chien search split across @pool
+ * @par_roots:  per-thread root counts and roots of the parallel Chien search
+ * @par_threads: number of threads @par_roots has room for
+ * @clmul_k:    carry-less multiply folding constant (NULL if backend unused)
+ * @genpoly:    generator polynomial, left-justified binary representation
  * @ecc_buf:    ecc parity words buffer
  * @ecc_buf2:   ecc parity words buffer
+ * @sliced_taps: bit-sliced encoder generator polynomial taps and distances
+ * @sliced_buf: bit-sliced encoder feedback bits (NULL until first used)
  * @xi_tab:     GF(2^m) base for solving degree 2 polynomial roots
+ * @deg2_tab:   one root of X^2+X+u indexed by u, or 0 (BCH_DEC_ROOT_TABLES)
+ * @deg3_tab:   one root of X^3+X+w indexed by w if it has 3 roots, or 0
  * @syn:        syndrome buffer
  * @cache:      log-based polynomial representation buffer
  * @elp:        error locator polynomial
+ * @btz_stack:  BTZ root finding work stack (t entries)
+ * @btz_basis:  BTZ trace basis, X^(2^i) mod f for i=0..m-1 (log representation)
+ * @btz_trace:  BTZ trace polynomials Tr(a^kX) mod f for k=1..m
+ * @mod_tab:    BTZ trace basis divisor row tables (NULL if unused or no room)
+ * @mod_avx2:   nonzero if gf_poly_mod() uses the AVX2 gather kernel
  * @poly_2t:    temporary polynomials of degree 2t
  */
 struct bch_control {
@@ -57,32 +113,163 @@ struct bch_control {
 	unsigned int    ecc_bits;
 	unsigned int    ecc_bytes;
 /* private: */
-	uint16_t       *a_pow_tab;
-	uint16_t       *a_log_tab;
+	unsigned int    flags;
+	const struct bch_fixed_codec *fixed;
+	unsigned int    enc_words;
+	bch_gf_t       *a_pow_tab;
+	bch_gf_t       *a_log_tab;
 	uint32_t       *mod8_tab;
+	uint32_t       *mod4_tab;
+	uint32_t       *crc_tab;
+	bch_gf_t       *syn_tab;
+	uint8_t        *syn_vec;
+	unsigned int    syn_lanes;
+	bch_gf_t       *minpoly_tab;
+	uint32_t       *upd_tab;
+	uint8_t        *chien_vec;
+	unsigned int    chien_lanes;
+	uint32_t       *chien_bits;
+	struct bch_thread_pool pool;
+	uint32_t       *par_bits;
+	unsigned int   *par_roots;
+	unsigned int    par_threads;
+	uint64_t       *clmul_k;
+	uint32_t       *genpoly;
 	uint32_t       *ecc_buf;
 	uint32_t       *ecc_buf2;
+	unsigned int   *sliced_taps;
+	uint64_t       *sliced_buf;
 	unsigned int   *xi_tab;
+	bch_gf_t       *deg2_tab;
+	bch_gf_t       *deg3_tab;
 	unsigned int   *syn;
 	int            *cache;
 	struct gf_poly *elp;
+	struct btz_item *btz_stack;
+	int            *btz_basis;
+	unsigned int   *btz_trace;
+	uint32_t       *mod_tab;
+	unsigned int    mod_avx2;
 	struct gf_poly *poly_2t[4];
     uint8_t        *databuf;
 };
 
+/**
+ * struct bch_encoder - persistent encoder context
+ * @bch:        BCH control structure the context was created for
+ * @ecc_buf:    ecc remainder, BCH_ECC_WORDS left-justified 32-bit words in
+ *              native byte order (byte-swapped on little-endian cpus)
+ */
+struct bch_encoder {
+	struct bch_control *bch;
+	uint32_t           *ecc_buf;
+};
+
+/**
+ * struct bch_iovec - data fragment for encodev_bch() and decodev_bch()
+ * @iov_base:   fragment start address
+ * @iov_len:    fragment length in bytes
+ *
+ * This has the same layout as POSIX struct iovec.
+ */
+struct bch_iovec {
+	const void *iov_base;
+	size_t      iov_len;
+};
+
+/* init_bch_ext() option flags */
+#define BCH_ENC_SLICE8   0x0001  /* slicing-by-8 encoder (8 remainder tables) */
+#define BCH_ENC_SLICE16  0x0002  /* slicing-by-16 encoder (16 remainder tables) */
+#define BCH_ENC_TABLE    0x0004  /* never use the carry-less multiply encoder */
+#define BCH_ENC_NIBBLE   0x0008  /* low-memory encoder, 16-entry table */
+#define BCH_ENC_LFSR     0x0010  /* low-memory encoder, no table (bitwise) */
+#define BCH_CRC32        0x0020  /* encode_bch_crc() computes CRC-32 */
+#define BCH_CRC32C       0x0040  /* encode_bch_crc() computes CRC-32C */
+#define BCH_DEC_SYN_TABLE 0x0080 /* byte-wise syndrome tables */
+#define BCH_DEC_SYN_MINPOLY 0x0100 /* syndromes via minimal polynomials */
+#define BCH_ECC_UPDATE   0x0200  /* bch_update_ecc() shift tables */
+#define BCH_DEC_IBM      0x0400  /* inversion-less Berlekamp-Massey */
+#define BCH_DEC_CHIEN    0x0800  /* Chien search when faster than BTZ */
+#define BCH_DEC_ROOT_TABLES 0x1000 /* low-degree polynomial root tables */
+
+/**
+ * struct bch_encode_out - encode_bch_crc() results
+ * @ecc:        ecc parity bytes, used both as input and output as in
+ *              encode_bch()
+ * @crc:        CRC of all data processed so far, used both as input and
+ *              output (0 before the first call)
+ */
+struct bch_encode_out {
+	uint8_t        *ecc;
+	uint32_t        crc;
+};
+
 struct bch_control *init_bch(int m, int t, unsigned int prim_poly);
 
+struct bch_control *init_bch_ext(int m, int t, unsigned int prim_poly,
+				 unsigned int flags);
+
 void free_bch(struct bch_control *bch);
 
 void encode_bch(struct bch_control *bch, const uint8_t *data,
 		unsigned int len, uint8_t *ecc);
 
+int encode_bch_crc(struct bch_control *bch, const uint8_t *data,
+		   unsigned int len, struct bch_encode_out *out);
+
+void encodev_bch(struct bch_control *bch, const struct bch_iovec *iov,
+		 unsigned int iovcnt, uint8_t *ecc);
+
+struct bch_encoder *init_bch_encoder(struct bch_control *bch);
+
+void free_bch_encoder(struct bch_encoder *enc);
+
+void encode_bch_init(struct bch_encoder *enc, const uint8_t *ecc);
+
+void encode_bch_update(struct bch_encoder *enc, const uint8_t *data,
+		       unsigned int len);
+
+void encode_bch_final(struct bch_encoder *enc, uint8_t *ecc);
+
+void encode_bch_batch(struct bch_control *bch, const uint8_t * const *data,
+		      unsigned int len, uint8_t * const *ecc,
+		      unsigned int count);
+
 void encodebits_bch(struct bch_control *bch, const uint8_t *data, uint8_t *ecc);
 
+int encodebits_bch_sliced(struct bch_control *bch, const uint64_t *data,
+			  unsigned int nbits, uint64_t *ecc,
+			  unsigned int lanes);
+
+void bch_slice_bits(const uint8_t * const *bits, unsigned int nbits,
+		    unsigned int count, uint64_t *sliced, unsigned int lanes);
+
+void bch_unslice_bits(const uint64_t *sliced, unsigned int nbits,
+		      unsigned int count, uint8_t * const *bits,
+		      unsigned int lanes);
+
+int bch_verify(struct bch_control *bch, const uint8_t *data, unsigned int len,
+	       const uint8_t *ecc);
+
+int bch_verify_batch(struct bch_control *bch, const uint8_t * const *data,
+		     unsigned int len, const uint8_t * const *ecc,
+		     unsigned int count, uint8_t *dirty);
+
+int bch_update_ecc(struct bch_control *bch, uint8_t *ecc, unsigned int len,
+		   unsigned int offset, const uint8_t *old_data,
+		   const uint8_t *new_data, unsigned int n);
+
+int bch_set_thread_pool(struct bch_control *bch,
+			const struct bch_thread_pool *pool);
+
 int decode_bch(struct bch_control *bch, const uint8_t *data, unsigned int len,
 	       const uint8_t *recv_ecc, const uint8_t *calc_ecc,
 	       const unsigned int *syn, unsigned int *errloc);
 
+int decodev_bch(struct bch_control *bch, const struct bch_iovec *iov,
+		unsigned int iovcnt, const uint8_t *recv_ecc,
+		unsigned int *errloc);
+
 int decodebits_bch(struct bch_control *bch, const uint8_t *data,
 	       const uint8_t *recv_ecc, unsigned int *errloc);
 
@@ -3,6 +3,7 @@
 extern crate bchlib_sys as ffi;
 unsafe impl Send for BCH {}
 
+use core::marker::PhantomData;
 use core::ptr;
 
 #[derive(Debug)]
@@ -20,8 +21,13 @@ impl BCH {
     }
     
     pub fn init_with_poly(m: i32, t: i32, poly: u32) -> Result<BCH, &'static str> {
+        BCH::init_with_flags(m, t, poly, 0)
+    }
+
+    /// Same as `init_with_poly`, with `ffi::BCH_*` option flags (e.g. `ffi::BCH_ENC_SLICE8`)
+    pub fn init_with_flags(m: i32, t: i32, poly: u32, flags: u32) -> Result<BCH, &'static str> {
         unsafe {
-            let bch = ffi::init_bch(m, t, poly);
+            let bch = ffi::init_bch_ext(m, t, poly, flags);
             if bch == ptr::null_mut() {
                 Err("Invalid BCH params")
             }
@@ -44,6 +50,22 @@ impl BCH {
         };
     }
 
+    /// Same as `encode_bits` on up to 64*`lanes` codewords at once (`lanes` is
+    /// 1 or 4), `nbits` data bits per codeword; `data` and `ecc` are in the
+    /// bit-sliced layout of `slice_bits`, and `ecc` must be zeroed first
+    pub fn encode_bits_sliced(&mut self, data: &[u64], nbits: usize, ecc: &mut [u64], lanes: usize) -> Result<(), &'static str> {
+        assert!(data.len() >= nbits * lanes && ecc.len() >= self.0.ecc_bits as usize * lanes);
+        let err = unsafe {
+            ffi::encodebits_bch_sliced(&mut self.0, data.as_ptr(), nbits as u32, ecc.as_mut_ptr(), lanes as u32)
+        };
+        if err < 0 {
+            Err("Unsupported lanes or code size")
+        }
+        else {
+            Ok(())
+        }
+    }
+
     pub fn decode(&mut self, msg: &[u8], ecc: &[u8], errloc: &mut[u32]) -> i32 {
         let err = unsafe {
             ffi::decode_bch(&mut self.0, msg.as_ptr(), msg.len() as u32, ecc.as_ptr(), core::ptr::null(), core::ptr::null(), errloc.as_mut_ptr())
@@ -57,6 +79,169 @@ impl BCH {
         };
     }
 
+    /// Encode consecutive `len`-byte messages of `msgs`, storing each ecc in
+    /// consecutive `ecc_bytes`-sized slots of `ecc`
+    pub fn encode_batch(&mut self, msgs: &[u8], len: usize, ecc: &mut [u8]) {
+        const CHUNK: usize = 16;
+        let ecc_bytes = self.0.ecc_bytes as usize;
+        let count = if len > 0 { msgs.len() / len } else { 0 };
+        assert!(ecc.len() >= count * ecc_bytes);
+
+        let mut i = 0;
+        while i < count {
+            let n = core::cmp::min(CHUNK, count - i);
+            let mut data = [ptr::null(); CHUNK];
+            let mut eccs = [ptr::null_mut(); CHUNK];
+            for j in 0..n {
+                data[j] = msgs[(i + j) * len..].as_ptr();
+                eccs[j] = ecc[(i + j) * ecc_bytes..].as_mut_ptr();
+            }
+            unsafe {
+                ffi::encode_bch_batch(&mut self.0, data.as_ptr(), len as u32, eccs.as_ptr(), n as u32);
+            };
+            i += n;
+        }
+    }
+
+    /// Check whether `msg` and `ecc` form an error-free codeword, without
+    /// locating errors
+    pub fn verify(&mut self, msg: &[u8], ecc: &[u8]) -> Result<bool, &'static str> {
+        let err = unsafe {
+            ffi::bch_verify(&mut self.0, msg.as_ptr(), msg.len() as u32, ecc.as_ptr())
+        };
+        if err < 0 {
+            Err("Invalid data length")
+        }
+        else {
+            Ok(err == 0)
+        }
+    }
+
+    /// Update `ecc` of a `len`-byte message after rewriting `old` with `new`
+    /// at `offset`, without reading the rest of the message
+    pub fn update_ecc(&mut self, ecc: &mut [u8], len: usize, offset: usize, old: &[u8], new: &[u8]) -> Result<(), &'static str> {
+        assert_eq!(old.len(), new.len());
+        let err = unsafe {
+            ffi::bch_update_ecc(&mut self.0, ecc.as_mut_ptr(), len as u32, offset as u32,
+                                old.as_ptr(), new.as_ptr(), old.len() as u32)
+        };
+        if err < 0 {
+            Err("Invalid data length or offset")
+        }
+        else {
+            Ok(())
+        }
+    }
+
+    /// Check consecutive `len`-byte messages of `msgs` against consecutive
+    /// `ecc_bytes`-sized slots of `ecc`, setting `dirty[i]` for codewords
+    /// with errors; returns the number of such codewords
+    pub fn verify_batch(&mut self, msgs: &[u8], len: usize, ecc: &[u8], dirty: &mut [bool]) -> Result<usize, &'static str> {
+        const CHUNK: usize = 16;
+        let ecc_bytes = self.0.ecc_bytes as usize;
+        let count = if len > 0 { msgs.len() / len } else { 0 };
+        assert!(ecc.len() >= count * ecc_bytes && dirty.len() >= count);
+
+        let mut ndirty = 0;
+        let mut i = 0;
+        while i < count {
+            let n = core::cmp::min(CHUNK, count - i);
+            let mut data = [ptr::null(); CHUNK];
+            let mut eccs = [ptr::null(); CHUNK];
+            let mut flags = [0u8; CHUNK];
+            for j in 0..n {
+                data[j] = msgs[(i + j) * len..].as_ptr();
+                eccs[j] = ecc[(i + j) * ecc_bytes..].as_ptr();
+            }
+            let err = unsafe {
+                ffi::bch_verify_batch(&mut self.0, data.as_ptr(), len as u32, eccs.as_ptr(), n as u32, flags.as_mut_ptr())
+            };
+            if err < 0 {
+                return Err("Invalid data length");
+            }
+            for j in 0..n {
+                dirty[i + j] = flags[j] != 0;
+            }
+            ndirty += err as usize;
+            i += n;
+        }
+        Ok(ndirty)
+    }
+
+    /// Same as `encode` on the concatenation of `msgs`, without copying them
+    pub fn encode_vectored(&mut self, msgs: &[&[u8]], ecc: &mut [u8]) {
+        const CHUNK: usize = 16;
+        for chunk in msgs.chunks(CHUNK) {
+            let mut iov = [ffi::bch_iovec { iov_base: ptr::null(), iov_len: 0 }; CHUNK];
+            for (v, msg) in iov.iter_mut().zip(chunk.iter()) {
+                v.iov_base = msg.as_ptr() as *const _;
+                v.iov_len = msg.len() as _;
+            }
+            unsafe {
+                ffi::encodev_bch(&mut self.0, iov.as_ptr(), chunk.len() as u32, ecc.as_mut_ptr());
+            };
+        }
+    }
+
+    /// Same as `decode` on the concatenation of `msgs` (at most 16 fragments),
+    /// without copying them; error locations are bit offsets into that
+    /// concatenation
+    pub fn decode_vectored(&mut self, msgs: &[&[u8]], ecc: &[u8], errloc: &mut [u32]) -> i32 {
+        const MAX_IOV: usize = 16;
+        assert!(msgs.len() <= MAX_IOV);
+        let mut iov = [ffi::bch_iovec { iov_base: ptr::null(), iov_len: 0 }; MAX_IOV];
+        for (v, msg) in iov.iter_mut().zip(msgs.iter()) {
+            v.iov_base = msg.as_ptr() as *const _;
+            v.iov_len = msg.len() as _;
+        }
+        unsafe {
+            ffi::decodev_bch(&mut self.0, iov.as_ptr(), msgs.len() as u32, ecc.as_ptr(), errloc.as_mut_ptr())
+        }
+    }
+
+    /// Same as `encode`, also updating `crc` with the CRC of `msg` (start
+    /// from 0); requires `ffi::BCH_CRC32` or `ffi::BCH_CRC32C` init flags
+    pub fn encode_crc(&mut self, msg: &[u8], ecc: &mut [u8], crc: &mut u32) -> Result<(), &'static str> {
+        let mut out = ffi::bch_encode_out { ecc: ecc.as_mut_ptr(), crc: *crc };
+        let err = unsafe {
+            ffi::encode_bch_crc(&mut self.0, msg.as_ptr(), msg.len() as u32, &mut out)
+        };
+        if err < 0 {
+            return Err("No CRC configured");
+        }
+        *crc = out.crc;
+        Ok(())
+    }
+
+    /// Create a persistent encoder context, for feeding a codeword in
+    /// fragments without converting the parity bytes at each call
+    pub fn encoder(&mut self) -> Result<Encoder<'_>, &'static str> {
+        let enc = unsafe { ffi::init_bch_encoder(&mut self.0) };
+        if enc == ptr::null_mut() {
+            Err("Encoder allocation failed")
+        }
+        else {
+            Ok(Encoder(enc, PhantomData))
+        }
+    }
+
+    /// Split long Chien searches across `pool`, or stop using a previous pool
+    /// with `None`; requires `ffi::BCH_DEC_CHIEN` init flags
+    ///
+    /// # Safety
+    ///
+    /// `pool.parallel_for` must have run all the calls it is given when it
+    /// returns, and `pool.ctx` must remain valid until the pool is replaced
+    pub unsafe fn set_thread_pool(&mut self, pool: Option<&ffi::bch_thread_pool>) -> Result<(), &'static str> {
+        let pool = pool.map_or(ptr::null(), |p| p as *const _);
+        if ffi::bch_set_thread_pool(&mut self.0, pool) < 0 {
+            Err("No vector Chien search, or allocation failed")
+        }
+        else {
+            Ok(())
+        }
+    }
+
     pub fn correct(&mut self, msg: &mut [u8], errloc: &[u32], nerr: i32) {
 	if nerr <=0 {
 	    return;
@@ -67,6 +252,66 @@ impl BCH {
     }
 }
 
+/// Transpose one-bit-per-byte codewords of `nbits` bits into `lanes` 64-bit
+/// words per bit, codeword c being bit c%64 of word c/64 (missing codewords
+/// are zero)
+pub fn slice_bits(bits: &[&[u8]], nbits: usize, sliced: &mut [u64], lanes: usize) {
+    let mut ptrs = [ptr::null(); 256];
+    assert!(bits.len() <= 64 * lanes && lanes <= 4 && sliced.len() >= nbits * lanes);
+    for (p, b) in ptrs.iter_mut().zip(bits.iter()) {
+        assert!(b.len() >= nbits);
+        *p = b.as_ptr();
+    }
+    unsafe {
+        ffi::bch_slice_bits(ptrs.as_ptr(), nbits as u32, bits.len() as u32, sliced.as_mut_ptr(), lanes as u32);
+    };
+}
+
+/// Inverse of `slice_bits`
+pub fn unslice_bits(sliced: &[u64], nbits: usize, bits: &mut [&mut [u8]], lanes: usize) {
+    let mut ptrs = [ptr::null_mut(); 256];
+    assert!(bits.len() <= 64 * lanes && lanes <= 4 && sliced.len() >= nbits * lanes);
+    for (p, b) in ptrs.iter_mut().zip(bits.iter_mut()) {
+        assert!(b.len() >= nbits);
+        *p = b.as_mut_ptr();
+    }
+    unsafe {
+        ffi::bch_unslice_bits(sliced.as_ptr(), nbits as u32, bits.len() as u32, ptrs.as_ptr(), lanes as u32);
+    };
+}
+
+/// Encoder context returned by `BCH::encoder`, with init/update/final semantics
+pub struct Encoder<'a>(*mut ffi::bch_encoder, PhantomData<&'a mut BCH>);
+
+impl<'a> Encoder<'a> {
+    /// Start a new codeword, from `ecc` parity bytes or from zero
+    pub fn init(&mut self, ecc: Option<&[u8]>) {
+        let ecc = ecc.map_or(ptr::null(), |e| e.as_ptr());
+        unsafe {
+            ffi::encode_bch_init(self.0, ecc);
+        };
+    }
+
+    pub fn update(&mut self, msg: &[u8]) {
+        unsafe {
+            ffi::encode_bch_update(self.0, msg.as_ptr(), msg.len() as u32);
+        };
+    }
+
+    pub fn finalize(&self, ecc: &mut [u8]) {
+        unsafe {
+            ffi::encode_bch_final(self.0, ecc.as_mut_ptr());
+        };
+    }
+}
+
+impl<'a> Drop for Encoder<'a> {
+    fn drop(&mut self) {
+        unsafe {
+            ffi::free_bch_encoder(self.0);
+        };
+    }
+}
 
 #[cfg(test)]
 mod tests {
@@ -94,6 +339,149 @@ mod tests {
         assert_eq!(errloc[1], 0);
     }
 
+    #[test]
+    fn test_decode_small_t() {
+        for &(m, t) in [(6, 1), (7, 2), (8, 3), (8, 4)].iter() {
+            for flags in [0, ffi::BCH_DEC_ROOT_TABLES].iter() {
+                let mut bch = BCH::init_with_flags(m, t, 0, *flags).unwrap();
+                let mut msg: Vec<u8> = (0..7u32).map(|i| (i * 29 + 5) as u8).collect();
+                let mut ecc = [0u8; 4];
+                bch.encode(&msg, &mut ecc);
+                for e in 0..(t as usize) {
+                    msg[2 * e] ^= 1 << e;
+                }
+                let mut errloc = [0u32; 4];
+                assert_eq!(bch.decode(&msg, &ecc, &mut errloc), t);
+                let mut errloc = errloc[..t as usize].to_vec();
+                errloc.sort();
+                let expected: Vec<u32> = (0..t as u32).map(|e| 16 * e + e).collect();
+                assert_eq!(errloc, expected);
+            }
+        }
+    }
+
+    #[test]
+    fn test_decode_chien() {
+        let mut msg: Vec<u8> = (0..8u32).map(|i| (i * 43 + 7) as u8).collect();
+        let mut ecc = [0u8; 6];
+        BCH::init(7, 6).unwrap().encode(&msg, &mut ecc);
+        for e in 0..6 {
+            msg[e + 1] ^= 0x80 >> e;
+        }
+        for flags in [0, ffi::BCH_DEC_CHIEN].iter() {
+            let mut bch = BCH::init_with_flags(7, 6, 0, *flags).unwrap();
+            let mut errloc = [0u32; 6];
+            assert_eq!(bch.decode(&msg, &ecc, &mut errloc), 6);
+            let mut errloc = errloc.to_vec();
+            errloc.sort();
+            let expected: Vec<u32> = (0..6u32).map(|e| 8 * (e + 1) + 7 - e).collect();
+            assert_eq!(errloc, expected);
+        }
+    }
+
+    #[test]
+    fn test_decode_btz_kernels() {
+        // BTZ factoring of large locators: row-table remainders for the trace
+        // basis, AVX2 gather remainders for divisors of degree >= 16, checked
+        // against the scalar remainder
+        let msg: Vec<u8> = (0..960u32).map(|i| (i * 71 + i / 5) as u8).collect();
+        let mut ecc = [0u8; 52];
+        BCH::init(13, 32).unwrap().encode(&msg, &mut ecc);
+        for &nerr in [17usize, 24, 32].iter() {
+            let mut msg = msg.clone();
+            for e in 0..nerr {
+                msg[29 * e + 3] ^= 0x80 >> (e % 8);
+            }
+            let mut results = Vec::new();
+            for kernels in 0..3 {
+                let mut bch = BCH::init(13, 32).unwrap();
+                if kernels < 2 {
+                    bch.0.mod_avx2 = 0;
+                }
+                if kernels < 1 {
+                    bch.0.mod_tab = ptr::null_mut();
+                }
+                let mut errloc = [0u32; 32];
+                assert_eq!(bch.decode(&msg, &ecc, &mut errloc), nerr as i32);
+                let mut errloc = errloc[..nerr].to_vec();
+                errloc.sort();
+                results.push(errloc);
+            }
+            let expected: Vec<u32> = (0..nerr as u32).map(|e| 8 * (29 * e + 3) + 7 - e % 8).collect();
+            assert_eq!(results[0], expected);
+            assert_eq!(results[1], expected);
+            assert_eq!(results[2], expected);
+        }
+    }
+
+    #[test]
+    fn test_decode_too_many_errors() {
+        // 7 errors with t = 6: the locator does not split, and BTZ factoring
+        // used to take a coprime trace for a factor and report 6 bogus roots
+        let mut msg: Vec<u8> = (0..16u32).map(|i| (i * 29 + 7) as u8).collect();
+        let mut ecc = [0u8; 6];
+        BCH::init(8, 6).unwrap().encode(&msg, &mut ecc);
+        for &p in [103, 87, 81, 59, 118, 105, 16].iter() {
+            msg[p / 8] ^= 1 << (p % 8);
+        }
+        for flags in [0, ffi::BCH_DEC_IBM].iter() {
+            let mut bch = BCH::init_with_flags(8, 6, 0, *flags).unwrap();
+            let mut errloc = [0u32; 6];
+            assert_eq!(bch.decode(&msg, &ecc, &mut errloc), -13);
+        }
+    }
+
+    unsafe extern "C" fn serial_for(_ctx: *mut core::ffi::c_void, count: u32,
+                                    f: Option<unsafe extern "C" fn(*mut core::ffi::c_void, u32)>,
+                                    arg: *mut core::ffi::c_void) {
+        let f = f.unwrap();
+        for i in 0..count {
+            f(arg, i);
+        }
+    }
+
+    #[test]
+    fn test_thread_pool() {
+        // large enough m.t for the split search to beat BTZ despite the
+        // dispatch cost, with a pool running its calls one after the other
+        let mut msg: Vec<u8> = (0..3584u32).map(|i| (i * 59 + i / 17) as u8).collect();
+        let mut ecc = [0u8; 120];
+        BCH::init(15, 64).unwrap().encode(&msg, &mut ecc);
+        for e in 0..64 {
+            msg[56 * e] ^= 1 << (e % 8);
+        }
+        let expected: Vec<u32> = (0..64u32).map(|e| 8 * 56 * e + e % 8).collect();
+        let pool = ffi::bch_thread_pool { parallel_for: Some(serial_for), ctx: ptr::null_mut(), nthreads: 64 };
+        let small = ffi::bch_thread_pool { nthreads: 48, ..pool };
+        for &pooled in [false, true].iter() {
+            let mut bch = BCH::init_with_flags(15, 64, 0, ffi::BCH_DEC_CHIEN).unwrap();
+            if pooled && unsafe { bch.set_thread_pool(Some(&pool)) }.is_err() {
+                // no vector Chien search on this target
+                assert!(bch.0.chien_vec.is_null());
+                return;
+            }
+            let mut errloc = [0u32; 64];
+            assert_eq!(bch.decode(&msg, &ecc, &mut errloc), 64);
+            let mut errloc = errloc.to_vec();
+            errloc.sort();
+            assert_eq!(errloc, expected);
+            assert!(unsafe { bch.set_thread_pool(None) }.is_ok());
+            if pooled {
+                // a smaller pool reuses the buffers of the previous one
+                let par_roots = bch.0.par_roots;
+                assert!(unsafe { bch.set_thread_pool(Some(&small)) }.is_ok());
+                assert_eq!(bch.0.par_roots, par_roots);
+                let mut errloc = [0u32; 64];
+                assert_eq!(bch.decode(&msg, &ecc, &mut errloc), 64);
+                let mut errloc = errloc.to_vec();
+                errloc.sort();
+                assert_eq!(errloc, expected);
+            }
+        }
+        let mut bch = BCH::init(15, 64).unwrap();
+        assert!(unsafe { bch.set_thread_pool(Some(&pool)) }.is_err());
+    }
+
     #[test]
     fn test_sync_codeword() {
         let mut bch = BCH::init(5, 2).unwrap();
@@ -105,6 +493,342 @@ mod tests {
         assert_eq!(errloc[1], 0);
     }
 
+    #[test]
+    fn test_encode_slicing() {
+        let msg: Vec<u8> = (0..509u32).map(|i| (i * 37 + 11) as u8).collect();
+        let mut bch = BCH::init(13, 8).unwrap();
+        let mut ecc = [0u8; 13];
+        bch.encode(&msg[1..], &mut ecc);
+        for flags in [ffi::BCH_ENC_TABLE, ffi::BCH_ENC_SLICE8, ffi::BCH_ENC_SLICE16,
+                      ffi::BCH_ENC_NIBBLE, ffi::BCH_ENC_LFSR].iter() {
+            let mut bch = BCH::init_with_flags(13, 8, 0, *flags).unwrap();
+            let mut ecc2 = [0u8; 13];
+            bch.encode(&msg[1..], &mut ecc2);
+            assert_eq!(ecc, ecc2);
+        }
+    }
+
+    #[test]
+    fn test_encode_bits_sliced() {
+        let mut bch = BCH::init(8, 4).unwrap();
+        let r = bch.0.ecc_bits as usize;
+        let nbits = bch.0.n as usize - r;
+        for &(lanes, count) in [(1, 64), (1, 37), (4, 256), (4, 203)].iter() {
+            let msgs: Vec<Vec<u8>> = (0..count as u32)
+                .map(|c| (0..nbits as u32).map(|i| ((i * 7 + c * 13 + i / 5) % 3 == 0) as u8).collect())
+                .collect();
+            let refs: Vec<&[u8]> = msgs.iter().map(|m| &m[..]).collect();
+            let mut data = vec![0u64; nbits * lanes];
+            slice_bits(&refs, nbits, &mut data, lanes);
+            let mut ecc = vec![0u64; r * lanes];
+            bch.encode_bits_sliced(&data, nbits, &mut ecc, lanes).unwrap();
+            let mut out = vec![vec![0u8; r]; count];
+            let mut outs: Vec<&mut [u8]> = out.iter_mut().map(|e| &mut e[..]).collect();
+            unslice_bits(&ecc, r, &mut outs, lanes);
+            for (msg, ecc) in msgs.iter().zip(out.iter()) {
+                let mut ecc2 = vec![0u8; r];
+                bch.encode_bits(msg, &mut ecc2);
+                assert_eq!(ecc, &ecc2);
+            }
+            let mut msgs2 = vec![vec![0u8; nbits]; count];
+            let mut outs: Vec<&mut [u8]> = msgs2.iter_mut().map(|m| &mut m[..]).collect();
+            unslice_bits(&data, nbits, &mut outs, lanes);
+            assert_eq!(msgs, msgs2);
+        }
+        let mut ecc = vec![0u64; 2 * r];
+        assert!(bch.encode_bits_sliced(&[0u64; 2], 1, &mut ecc, 2).is_err());
+        assert!(BCH::init(13, 24).unwrap().encode_bits_sliced(&[0u64; 1], 1, &mut [0u64; 312], 1).is_err());
+    }
+
+    #[test]
+    fn test_encode_batch() {
+        let mut bch = BCH::init(13, 8).unwrap();
+        let msgs: Vec<u8> = (0..9 * 512u32).map(|i| (i * 7 + i / 13) as u8).collect();
+        let mut ecc = [0u8; 9 * 13];
+        bch.encode_batch(&msgs, 512, &mut ecc);
+        for (msg, ecc) in msgs.chunks(512).zip(ecc.chunks(13)) {
+            let mut ecc2 = [0u8; 13];
+            bch.encode(msg, &mut ecc2);
+            assert_eq!(ecc, &ecc2[..]);
+        }
+    }
+
+    #[test]
+    fn test_encoder() {
+        let msg: Vec<u8> = (0..512u32).map(|i| (i * 13 + 5) as u8).collect();
+        for flags in [0, ffi::BCH_ENC_TABLE, ffi::BCH_ENC_NIBBLE].iter() {
+            let mut bch = BCH::init_with_flags(13, 8, 0, *flags).unwrap();
+            let mut ecc = [0u8; 13];
+            bch.encode(&msg, &mut ecc);
+            let mut head = [0u8; 13];
+            bch.encode(&msg[..100], &mut head);
+            let mut enc = bch.encoder().unwrap();
+            for frag in msg.chunks(7) {
+                enc.update(frag);
+            }
+            let mut ecc2 = [0u8; 13];
+            enc.finalize(&mut ecc2);
+            assert_eq!(ecc, ecc2);
+            // resume from parity bytes, finalizing in between
+            enc.init(Some(&head));
+            for frag in msg[100..].chunks(97) {
+                enc.update(frag);
+                enc.finalize(&mut ecc2);
+            }
+            assert_eq!(ecc, ecc2);
+        }
+    }
+
+    #[test]
+    fn test_encode_vectored() {
+        let mut bch = BCH::init(13, 8).unwrap();
+        let msg: Vec<u8> = (0..536u32).map(|i| (i * 29 + 3) as u8).collect();
+        let mut ecc = [0u8; 13];
+        bch.encode(&msg, &mut ecc);
+        let frags: Vec<&[u8]> = vec![&msg[..16], &msg[16..17], &msg[17..528], &msg[528..]];
+        let mut ecc2 = [0u8; 13];
+        bch.encode_vectored(&frags, &mut ecc2);
+        assert_eq!(ecc, ecc2);
+    }
+
+    #[test]
+    fn test_decode_vectored() {
+        let mut msg: Vec<u8> = (0..536u32).map(|i| (i * 31 + 9) as u8).collect();
+        for flags in [0, ffi::BCH_ENC_NIBBLE].iter() {
+            let mut bch = BCH::init_with_flags(13, 8, 0, *flags).unwrap();
+            let mut ecc = [0u8; 13];
+            bch.encode(&msg, &mut ecc);
+            msg[5] ^= 0x20;
+            msg[16] ^= 0x01;
+            msg[530] ^= 0x80;
+            let frags: Vec<&[u8]> = vec![&msg[..16], &msg[16..17], &msg[17..528], &msg[528..]];
+            let mut errloc = [0u32; 8];
+            assert_eq!(bch.decode_vectored(&frags, &ecc, &mut errloc), 3);
+            let mut errloc = errloc[..3].to_vec();
+            errloc.sort();
+            assert_eq!(errloc, [5 * 8 + 5, 16 * 8, 530 * 8 + 7]);
+            msg[5] ^= 0x20;
+            msg[16] ^= 0x01;
+            msg[530] ^= 0x80;
+            // lengths summing past the codeword must not wrap around
+            let iov = [ffi::bch_iovec { iov_base: msg.as_ptr() as *const _, iov_len: usize::MAX },
+                       ffi::bch_iovec { iov_base: msg.as_ptr() as *const _, iov_len: 11 }];
+            let err = unsafe {
+                ffi::decodev_bch(&mut bch.0, iov.as_ptr(), 2, ecc.as_ptr(), errloc.as_mut_ptr())
+            };
+            assert!(err < 0);
+        }
+    }
+
+    #[test]
+    fn test_encode_crc() {
+        let msg: Vec<u8> = (0..512u32).map(|i| (i * 19 + 7) as u8).collect();
+        let mut ecc = [0u8; 13];
+        BCH::init(13, 8).unwrap().encode(&msg, &mut ecc);
+        for (flags, check) in [(ffi::BCH_CRC32, 0xcbf43926u32), (ffi::BCH_CRC32C, 0xe3069283)].iter() {
+            let mut bch = BCH::init_with_flags(13, 8, 0, *flags).unwrap();
+            let mut ecc2 = [0u8; 13];
+            let mut crc = 0;
+            bch.encode_crc(b"123456789", &mut ecc2, &mut crc).unwrap();
+            assert_eq!(crc, *check);
+            ecc2 = [0u8; 13];
+            crc = 0;
+            bch.encode_crc(&msg[..101], &mut ecc2, &mut crc).unwrap();
+            bch.encode_crc(&msg[101..], &mut ecc2, &mut crc).unwrap();
+            assert_eq!(ecc, ecc2);
+            let mut crc2 = 0;
+            bch.encode_crc(&msg, &mut [0u8; 13], &mut crc2).unwrap();
+            assert_eq!(crc, crc2);
+        }
+        let mut crc = 0;
+        assert!(BCH::init(13, 8).unwrap().encode_crc(&msg, &mut ecc, &mut crc).is_err());
+    }
+
+    #[test]
+    fn test_decode_syndromes() {
+        let mut msg: Vec<u8> = (0..512u32).map(|i| (i * 11 + 1) as u8).collect();
+        let mut ecc = [0u8; 13];
+        BCH::init(13, 8).unwrap().encode(&msg, &mut ecc);
+        msg[3] ^= 0x10;
+        msg[300] ^= 0x81;
+        ecc[12] ^= 0x08;
+        for flags in [ffi::BCH_DEC_SYN_TABLE, ffi::BCH_DEC_SYN_TABLE | ffi::BCH_ENC_NIBBLE,
+                      ffi::BCH_DEC_SYN_TABLE | ffi::BCH_ENC_LFSR, ffi::BCH_DEC_SYN_MINPOLY,
+                      ffi::BCH_DEC_IBM].iter() {
+            let mut bch = BCH::init_with_flags(13, 8, 0, *flags).unwrap();
+            let mut errloc = [0u32; 8];
+            assert_eq!(bch.decode(&msg, &ecc, &mut errloc), 4);
+            let mut errloc = errloc[..4].to_vec();
+            errloc.sort();
+            assert_eq!(errloc, [3 * 8 + 4, 300 * 8, 300 * 8 + 7, 512 * 8 + 12 * 8 + 3]);
+        }
+    }
+
+    fn syndromes(bch: &BCH) -> Vec<u32> {
+        unsafe { core::slice::from_raw_parts(bch.0.syn, 2 * bch.0.t as usize).to_vec() }
+    }
+
+    #[test]
+    fn test_syndromes_vec() {
+        // BCH_DEC_SYN_TABLE with direct syndrome evaluation uses the pshufb
+        // kernels from 16 bytes on (32-byte lanes from 128 bytes with AVX2);
+        // check them against syndromes of the ecc remainder
+        let mut msg: Vec<u8> = (0..1000u32).map(|i| (i * 53 + i / 9) as u8).collect();
+        let mut ecc = [0u8; 13];
+        BCH::init(13, 8).unwrap().encode(&msg, &mut ecc);
+        for e in 0..12 {
+            msg[83 * e + 1] ^= 1 << (e % 8);
+        }
+        let mut reference = BCH::init(13, 8).unwrap();
+        let mut errloc = [0u32; 8];
+        for &lanes in [32, 16].iter() {
+            let mut bch = BCH::init_with_flags(13, 8, 0, ffi::BCH_DEC_SYN_TABLE | ffi::BCH_ENC_NIBBLE).unwrap();
+            // both kernels share their tables, force the 16-byte one
+            if bch.0.syn_lanes > lanes {
+                bch.0.syn_lanes = lanes;
+            }
+            for &len in [16usize, 100, 128, 129, 200, 256, 511, 1000].iter() {
+                reference.decode(&msg[..len], &ecc, &mut errloc);
+                bch.decode(&msg[..len], &ecc, &mut errloc);
+                assert_eq!(syndromes(&bch), syndromes(&reference));
+            }
+        }
+    }
+
+    #[test]
+    fn test_verify() {
+        let mut bch = BCH::init(13, 8).unwrap();
+        let mut msgs: Vec<u8> = (0..6 * 512u32).map(|i| (i * 17 + i / 7) as u8).collect();
+        let mut ecc = [0u8; 6 * 13];
+        bch.encode_batch(&msgs, 512, &mut ecc);
+        assert_eq!(bch.verify(&msgs[..512], &ecc[..13]), Ok(true));
+        msgs[2 * 512 + 100] ^= 0x04;
+        ecc[5 * 13 + 2] ^= 0x80;
+        assert_eq!(bch.verify(&msgs[1024..1536], &ecc[26..39]), Ok(false));
+        let mut dirty = [false; 6];
+        assert_eq!(bch.verify_batch(&msgs, 512, &ecc, &mut dirty), Ok(2));
+        assert_eq!(dirty, [false, false, true, false, false, true]);
+    }
+
+    #[test]
+    fn test_update_ecc() {
+        let mut msg: Vec<u8> = (0..1000u32).map(|i| (i * 7 + i / 3) as u8).collect();
+        for flags in [0, ffi::BCH_ECC_UPDATE, ffi::BCH_ECC_UPDATE | ffi::BCH_ENC_TABLE,
+                      ffi::BCH_ECC_UPDATE | ffi::BCH_ENC_NIBBLE].iter() {
+            let mut bch = BCH::init_with_flags(13, 8, 0, *flags).unwrap();
+            let mut ecc = [0u8; 13];
+            bch.encode(&msg, &mut ecc);
+            for &(offset, n) in [(0, 3), (17, 40), (500, 1), (999, 1)].iter() {
+                let old = msg[offset..offset + n].to_vec();
+                for b in msg[offset..offset + n].iter_mut() {
+                    *b = !*b ^ (offset as u8);
+                }
+                bch.update_ecc(&mut ecc, 1000, offset, &old, &msg[offset..offset + n]).unwrap();
+                let mut ecc2 = [0u8; 13];
+                bch.encode(&msg, &mut ecc2);
+                assert_eq!(ecc, ecc2);
+            }
+            assert!(bch.update_ecc(&mut ecc, 1000, 999, &[0, 0], &[1, 1]).is_err());
+        }
+    }
+
+    #[cfg(feature = "wide-field")]
+    #[test]
+    fn test_decode_wide_field() {
+        let mut bch = BCH::init(17, 8).unwrap();
+        let mut msg: Vec<u8> = (0..12000u32).map(|i| (i * 97 + 13) as u8).collect();
+        let mut ecc = [0u8; 17];
+        bch.encode(&msg, &mut ecc);
+        for e in 0..8 {
+            msg[1499 * e] ^= 1 << e;
+        }
+        let mut errloc = [0u32; 8];
+        assert_eq!(bch.decode(&msg, &ecc, &mut errloc), 8);
+        let mut errloc = errloc.to_vec();
+        errloc.sort();
+        let expected: Vec<u32> = (0..8u32).map(|e| 8 * 1499 * e + e).collect();
+        assert_eq!(errloc, expected);
+    }
+
+    #[test]
+    fn test_fixed_codec() {
+        // the tests build bchlib-sys with a codec specialized for (14, 16),
+        // see its test-fixed-params feature; a copy with `fixed` cleared runs
+        // the generic code on the same control structure
+        let msg: Vec<u8> = (0..2000u32).map(|i| (i * 41 + i / 11) as u8).collect();
+        for &flags in [0, ffi::BCH_ENC_SLICE16 | ffi::BCH_DEC_CHIEN,
+                       ffi::BCH_ENC_NIBBLE | ffi::BCH_DEC_IBM].iter() {
+            let mut fixed = BCH::init_with_flags(14, 16, 0, flags).unwrap();
+            assert!(!fixed.0.fixed.is_null());
+            let mut generic = BCH(fixed.0);
+            generic.0.fixed = ptr::null();
+
+            let mut ecc = [0u8; 28];
+            let mut ecc2 = [0u8; 28];
+            fixed.encode(&msg, &mut ecc);
+            generic.encode(&msg, &mut ecc2);
+            assert_eq!(ecc, ecc2);
+            let mut ecc2 = [0u8; 28];
+            fixed.encode_vectored(&[&msg[..3], &msg[3..1001], &msg[1001..]], &mut ecc2);
+            assert_eq!(ecc, ecc2);
+            {
+                let mut enc = fixed.encoder().unwrap();
+                enc.init(Some(&[0xff; 28]));
+                enc.init(None);
+                enc.update(&msg[..777]);
+                enc.update(&msg[777..]);
+                enc.finalize(&mut ecc2);
+            }
+            assert_eq!(ecc, ecc2);
+            assert_eq!(fixed.verify(&msg, &ecc), Ok(true));
+
+            let mut bad = msg.clone();
+            for e in 0..16 {
+                bad[123 * e + 5] ^= 1 << (e % 8);
+            }
+            let expected: Vec<u32> = (0..16u32).map(|e| 8 * (123 * e + 5) + e % 8).collect();
+            for bch in [&mut fixed, &mut generic].iter_mut() {
+                let mut errloc = [0u32; 16];
+                assert_eq!(bch.decode(&bad, &ecc, &mut errloc), 16);
+                let mut sorted = errloc.to_vec();
+                sorted.sort();
+                assert_eq!(sorted, expected);
+                let mut errloc = [0u32; 16];
+                assert_eq!(bch.decode_vectored(&[&bad[..1000], &bad[1000..]], &ecc, &mut errloc), 16);
+                let mut fixed_msg = bad.clone();
+                bch.correct(&mut fixed_msg, &errloc, 16);
+                assert_eq!(fixed_msg, msg);
+            }
+
+            let nbits = (fixed.0.n - fixed.0.ecc_bits) as usize;
+            let bits: Vec<u8> = (0..nbits as u32).map(|i| ((i * 5 + i / 13) % 7 == 0) as u8).collect();
+            let mut ecc = [0u8; 224];
+            let mut ecc2 = [0u8; 224];
+            fixed.encode_bits(&bits, &mut ecc);
+            generic.encode_bits(&bits, &mut ecc2);
+            assert_eq!(&ecc[..], &ecc2[..]);
+            let mut bad = bits.clone();
+            bad[0] ^= 1;
+            bad[nbits - 1] ^= 1;
+            let mut errloc = [0u32; 16];
+            assert_eq!(fixed.decode_bits(&bad, &ecc, &mut errloc), 2);
+            unsafe {
+                ffi::correctbits_bch(&mut fixed.0, bad.as_mut_ptr(), errloc.as_mut_ptr(), 2);
+            }
+            assert_eq!(bad, bits);
+
+            let pool = ffi::bch_thread_pool { parallel_for: Some(serial_for), ctx: ptr::null_mut(), nthreads: 4 };
+            let pooled = unsafe { fixed.set_thread_pool(Some(&pool)) };
+            assert_eq!(pooled.is_ok(), !fixed.0.chien_vec.is_null());
+            assert!(unsafe { fixed.set_thread_pool(None) }.is_ok());
+        }
+        unsafe {
+            let bch = ffi::init_bch_ext(14, 16, 0, 0);
+            assert!(!(*bch).fixed.is_null());
+            ffi::free_bch(bch);
+        }
+    }
+
     #[test]
     fn test_init_fail() {
         let bch = BCH::init_with_poly(5, 2, 1897);